@@ -0,0 +1,268 @@
+#include "AsyncUploader.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+/// <param name="allocator">Used for the staging buffers, which are freed once their batch has been consumed</param>
+/// <param name="transferFamily">The family of transferQueue, the graphics family when there's no dedicated transfer family</param>
+void AsyncUploader::init(VkDevice device, GpuAllocator* allocator, uint32_t transferFamily, VkQueue transferQueue, uint32_t graphicsFamily) {
+	this->device = device;
+	this->allocator = allocator;
+	this->transferFamily = transferFamily;
+	this->transferQueue = transferQueue;
+	this->graphicsFamily = graphicsFamily;
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = transferFamily;
+
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the transfer command pool!");
+	}
+}
+
+/// <summary>
+/// Frees every batch, the device must be idle
+/// </summary>
+void AsyncUploader::destroy() {
+	for (auto& batch : batches) {
+		destroyBatch(batch);
+	}
+	batches.clear();
+	destroyBatch(recording);
+
+	vkDestroyCommandPool(device, commandPool, nullptr);
+	commandPool = VK_NULL_HANDLE;
+}
+
+bool AsyncUploader::isDedicated() const {
+	return transferFamily != graphicsFamily;
+}
+
+/// <summary>
+/// Queues a copy into the buffer
+/// </summary>
+/// <param name="dstStage">The stage the buffer is first used in on the graphics queue</param>
+/// <param name="dstAccess">How the buffer is first accessed on the graphics queue</param>
+void AsyncUploader::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size,
+	VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+	Batch& batch = currentBatch();
+	StagingBuffer staging = createStaging(data, size);
+	batch.staging.push_back(staging);
+
+	VkBufferCopy copyRegion{};
+	copyRegion.dstOffset = offset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(batch.comBuffer, staging.buffer, buffer, 1, &copyRegion);
+
+	if (isDedicated()) {
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = transferFamily;
+		barrier.dstQueueFamilyIndex = graphicsFamily;
+		barrier.buffer = buffer;
+		barrier.offset = offset;
+		barrier.size = size;
+
+		// Release, the destination access is ignored on this side
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(batch.comBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, 1, &barrier, 0, nullptr);
+
+		// Acquire, the source access is ignored on that side
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dstAccess;
+		batch.bufferAcquires.push_back(barrier);
+	}
+
+	batch.dstStages |= dstStage;
+}
+
+/// <summary>
+/// Queues a copy into the image and moves it into finalLayout. The regions' buffer offsets are relative to data
+/// </summary>
+/// <param name="mipLevels">Mip levels of the image, all of them are transitioned</param>
+/// <param name="finalLayout">The layout the image is first used in on the graphics queue</param>
+void AsyncUploader::uploadImage(VkImage image, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& regions, uint32_t mipLevels,
+	VkImageLayout finalLayout, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+	Batch& batch = currentBatch();
+	StagingBuffer staging = createStaging(data, size);
+	batch.staging.push_back(staging);
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(batch.comBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkCmdCopyBufferToImage(batch.comBuffer, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()), regions.data());
+
+	// The layout transition is part of the release. With a dedicated family the acquire repeats it, but it only happens once
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = finalLayout;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	if (isDedicated()) {
+		barrier.srcQueueFamilyIndex = transferFamily;
+		barrier.dstQueueFamilyIndex = graphicsFamily;
+	}
+	vkCmdPipelineBarrier(batch.comBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	if (isDedicated()) {
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dstAccess;
+		batch.imageAcquires.push_back(barrier);
+	}
+
+	batch.dstStages |= dstStage;
+}
+
+/// <summary>
+/// Submits the uploads queued since the last flush to the transfer queue, without waiting for them
+/// </summary>
+void AsyncUploader::flush() {
+	if (recording.comBuffer == VK_NULL_HANDLE) { return; }
+
+	if (vkEndCommandBuffer(recording.comBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record the upload command buffer!");
+	}
+
+	// The graphics frame waiting on the semaphore completes after the transfer, so its fence covers the batch too
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &recording.semaphore) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the upload semaphore!");
+	}
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &recording.comBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &recording.semaphore;
+
+	if (vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit the uploads!");
+	}
+
+	batches.push_back(std::move(recording));
+	recording = Batch{};
+}
+
+/// <summary>
+/// Makes every submitted batch available to a graphics frame, records the ownership acquires into its command buffer
+/// (outside of a render pass) and adds the batches' semaphores to the frame's submit
+/// </summary>
+/// <param name="frame">Number of the frame being recorded, the batch is freed once it has completed</param>
+void AsyncUploader::acquire(VkCommandBuffer comBuffer, uint64_t frame, std::vector<VkSemaphore>& waitSemaphores, std::vector<VkPipelineStageFlags>& waitStages) {
+	for (auto& batch : batches) {
+		if (batch.acquired) { continue; }
+
+		// The semaphore wait and the acquire share the stages, so the barrier is chained after the wait
+		if (!batch.bufferAcquires.empty() || !batch.imageAcquires.empty()) {
+			vkCmdPipelineBarrier(comBuffer, batch.dstStages, batch.dstStages, 0, 0, nullptr,
+				static_cast<uint32_t>(batch.bufferAcquires.size()), batch.bufferAcquires.data(),
+				static_cast<uint32_t>(batch.imageAcquires.size()), batch.imageAcquires.data());
+		}
+
+		waitSemaphores.push_back(batch.semaphore);
+		waitStages.push_back(batch.dstStages);
+
+		batch.acquired = true;
+		batch.acquiredFrame = frame;
+	}
+}
+
+/// <summary>
+/// Frees the batches whose graphics frame has completed, which also means their transfer work has
+/// </summary>
+void AsyncUploader::collect(uint64_t completedFrames) {
+	while (!batches.empty()) {
+		Batch& batch = batches.front();
+		if (!batch.acquired || batch.acquiredFrame >= completedFrames) { break; }
+
+		destroyBatch(batch);
+		batches.pop_front();
+	}
+}
+
+/// <summary>
+/// Gets the batch being recorded, beginning a new one if needed
+/// </summary>
+AsyncUploader::Batch& AsyncUploader::currentBatch() {
+	if (recording.comBuffer != VK_NULL_HANDLE) { return recording; }
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+
+	if (vkAllocateCommandBuffers(device, &allocInfo, &recording.comBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate the upload command buffer!");
+	}
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(recording.comBuffer, &beginInfo);
+
+	return recording;
+}
+
+/// <summary>
+/// Creates a host visible staging buffer from the linear pools holding a copy of data
+/// </summary>
+AsyncUploader::StagingBuffer AsyncUploader::createStaging(const void* data, VkDeviceSize size) {
+	StagingBuffer staging;
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &staging.buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create staging buffer!");
+	}
+
+	staging.memory = allocator->allocateBuffer(staging.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		AllocationStrategy::Linear);
+	memcpy(staging.memory.mapped, data, static_cast<size_t>(size));
+
+	return staging;
+}
+
+void AsyncUploader::destroyBatch(Batch& batch) {
+	for (auto& staging : batch.staging) {
+		vkDestroyBuffer(device, staging.buffer, nullptr);
+		allocator->free(staging.memory);
+	}
+	batch.staging.clear();
+
+	if (batch.comBuffer != VK_NULL_HANDLE) {
+		vkFreeCommandBuffers(device, commandPool, 1, &batch.comBuffer);
+	}
+	if (batch.semaphore != VK_NULL_HANDLE) {
+		vkDestroySemaphore(device, batch.semaphore, nullptr);
+	}
+
+	batch = Batch{};
+}
@@ -0,0 +1,70 @@
+#ifndef ASYNCUPLOADER_H
+#define ASYNCUPLOADER_H
+
+#include <vulkan/vulkan.h>
+
+#include "GpuAllocator.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/// <summary>
+/// Copies data into device local buffers and images on the transfer queue, so big uploads overlap rendering instead of blocking it.
+/// Uploads are batched until flush(), each batch signals a semaphore the first graphics submit after it waits on.
+/// With a dedicated transfer family the resources are released to the graphics family on the transfer queue and acquired again
+/// by acquire() in the graphics command buffer. Without one the uploads run on the graphics family and no ownership changes hands
+/// </summary>
+class AsyncUploader {
+public:
+	void init(VkDevice device, GpuAllocator* allocator, uint32_t transferFamily, VkQueue transferQueue, uint32_t graphicsFamily);
+	void destroy();
+
+	bool isDedicated() const;
+
+	// The destination must be created with TRANSFER_DST and EXCLUSIVE sharing, and outlive the graphics frame that acquires it
+	void uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size,
+		VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+	void uploadImage(VkImage image, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& regions, uint32_t mipLevels,
+		VkImageLayout finalLayout, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+	void flush();
+	void acquire(VkCommandBuffer comBuffer, uint64_t frame, std::vector<VkSemaphore>& waitSemaphores, std::vector<VkPipelineStageFlags>& waitStages);
+	void collect(uint64_t completedFrames);
+
+private:
+	struct StagingBuffer {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		GpuAllocation memory;
+	};
+
+	struct Batch {
+		VkCommandBuffer comBuffer = VK_NULL_HANDLE;
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+		std::vector<StagingBuffer> staging;
+
+		// Recorded on the graphics side by acquire(), only used with a dedicated transfer family
+		std::vector<VkBufferMemoryBarrier> bufferAcquires;
+		std::vector<VkImageMemoryBarrier> imageAcquires;
+		VkPipelineStageFlags dstStages = 0;
+
+		bool acquired = false;
+		uint64_t acquiredFrame = 0;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	GpuAllocator* allocator = nullptr;
+	VkQueue transferQueue = VK_NULL_HANDLE;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	uint32_t transferFamily = 0;
+	uint32_t graphicsFamily = 0;
+
+	Batch recording; // Collects the uploads until the next flush
+	std::deque<Batch> batches; // Submitted, in submission order
+
+	Batch& currentBatch();
+	StagingBuffer createStaging(const void* data, VkDeviceSize size);
+	void destroyBatch(Batch& batch);
+};
+
+#endif // !ASYNCUPLOADER_H
@@ -0,0 +1,30 @@
+#include "DeletionQueue.hpp"
+
+/// <summary>
+/// Queues a destroy function
+/// </summary>
+/// <param name="frameCount">Number of submitted frames that may use the resources, they're destroyed once that many frames have completed</param>
+void DeletionQueue::push(uint64_t frameCount, std::function<void()> destroy) {
+	entries.push_back({ frameCount, std::move(destroy) });
+}
+
+/// <summary>
+/// Runs the destroy functions of every entry that no incomplete frame can use anymore
+/// </summary>
+/// <param name="completedFrames">Number of frames the GPU has finished, e.g. known from the fence that was just waited on</param>
+void DeletionQueue::flush(uint64_t completedFrames) {
+	while (!entries.empty() && entries.front().frameCount <= completedFrames) {
+		entries.front().destroy();
+		entries.pop_front();
+	}
+}
+
+/// <summary>
+/// Runs every destroy function, the device must be idle
+/// </summary>
+void DeletionQueue::flushAll() {
+	while (!entries.empty()) {
+		entries.front().destroy();
+		entries.pop_front();
+	}
+}
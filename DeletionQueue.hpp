@@ -0,0 +1,27 @@
+#ifndef DELETIONQUEUE_H
+#define DELETIONQUEUE_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+/// <summary>
+/// Defers destroying resources that frames still in flight may use, until those frames have completed on the GPU.
+/// Frames are counted from 0, in submission order
+/// </summary>
+class DeletionQueue {
+public:
+	void push(uint64_t frameCount, std::function<void()> destroy);
+	void flush(uint64_t completedFrames);
+	void flushAll();
+
+private:
+	struct Entry {
+		uint64_t frameCount;
+		std::function<void()> destroy;
+	};
+
+	std::deque<Entry> entries; // Pushed in order, so the frame counts never decrease
+};
+
+#endif // !DELETIONQUEUE_H
@@ -0,0 +1,388 @@
+#include "DeviceSelector.hpp"
+
+#include "GpuAllocator.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+// The probe copies a buffer back and forth between two device local buffers of this size
+const VkDeviceSize PROBE_BYTES = 32ull * 1024 * 1024;
+const uint32_t PROBE_COPIES = 8;
+
+/// <summary>
+/// Rates every physical device and returns the best suitable one, or the pinned one when a UUID is given.
+/// Throws when no device is suitable, or when the pinned device is missing or unsuitable
+/// </summary>
+/// <param name="check">The app's hard requirements, e.g. queue families, extensions and swap chain support</param>
+/// <param name="optionalExtensions">Extensions the app makes use of when they're there, each one raises the score</param>
+/// <param name="pinnedUuid">deviceUUID of the device to use, with or without dashes, empty to rank them</param>
+/// <param name="probe">Whether to run a short copy benchmark on every suitable device, it adds its bandwidth to the score</param>
+VkPhysicalDevice DeviceSelector::select(VkInstance instance, uint32_t instanceApiVersion, const RequirementCheck& check,
+	const std::vector<const char*>& optionalExtensions, const std::string& pinnedUuid, bool probe) {
+	uint32_t deviceCount = 0;
+	vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+
+	if (deviceCount == 0) {
+		throw std::runtime_error("Failed to find GPUs with Vulkan support!");
+	}
+
+	std::vector<VkPhysicalDevice> devices(deviceCount);
+	vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+	candidates.clear();
+	for (auto device : devices) {
+		DeviceCandidate candidate = describe(device, instanceApiVersion, optionalExtensions);
+		candidate.rejection = check(device);
+
+		if (candidate.rejection.empty()) {
+			if (probe) {
+				candidate.copyGBps = probeCopyBandwidth(device);
+			}
+			candidate.score = rate(candidate);
+		}
+		candidates.push_back(candidate);
+	}
+
+	const DeviceCandidate* chosen = nullptr;
+	if (!pinnedUuid.empty()) {
+		std::string wanted = normalizeUuid(pinnedUuid);
+		for (const auto& candidate : candidates) {
+			if (!candidate.uuid.empty() && candidate.uuid == wanted) {
+				chosen = &candidate;
+			}
+		}
+
+		if (chosen == nullptr) {
+			printCandidates(nullptr);
+			throw std::runtime_error("No GPU has the UUID " + pinnedUuid);
+		}
+		if (!chosen->rejection.empty()) {
+			printCandidates(nullptr);
+			throw std::runtime_error(std::string("The pinned GPU ") + chosen->properties.deviceName + " can't be used: " + chosen->rejection);
+		}
+	}
+	else {
+		for (const auto& candidate : candidates) {
+			if (candidate.rejection.empty() && (chosen == nullptr || candidate.score > chosen->score)) {
+				chosen = &candidate;
+			}
+		}
+
+		if (chosen == nullptr) {
+			printCandidates(nullptr);
+			throw std::runtime_error("Failed to find a suitable GPU!");
+		}
+	}
+
+	printCandidates(chosen);
+	return chosen->device;
+}
+
+const std::vector<DeviceCandidate>& DeviceSelector::getCandidates() const {
+	return candidates;
+}
+
+/// <summary>
+/// Prints a line per device with its score and what it was rated on, or why it was rejected
+/// </summary>
+/// <param name="chosen">The selected device, marked in the list. Null when selection failed</param>
+void DeviceSelector::printCandidates(const DeviceCandidate* chosen) const {
+	std::cout << "GPUs:\n";
+	for (const auto& candidate : candidates) {
+		std::cout << (&candidate == chosen ? " * " : "   ") << candidate.properties.deviceName
+			<< " [" << (candidate.uuid.empty() ? "no UUID" : candidate.uuid) << "]";
+
+		if (!candidate.rejection.empty()) {
+			std::cout << " rejected: " << candidate.rejection << "\n";
+			continue;
+		}
+
+		std::cout << " score " << candidate.score << ": "
+			<< (candidate.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU ? "discrete" :
+				candidate.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU ? "integrated" : "other")
+			<< ", " << (candidate.deviceLocalBytes >> 20) << " MiB device local"
+			<< (candidate.dedicatedTransfer ? ", dedicated transfer" : "")
+			<< (candidate.asyncCompute ? ", async compute" : "")
+			<< ", " << candidate.optionalExtensions << " optional extensions";
+		if (candidate.copyGBps > 0.0) {
+			std::cout << ", copies " << std::fixed << std::setprecision(1) << candidate.copyGBps << " GB/s" << std::defaultfloat;
+		}
+		std::cout << "\n";
+	}
+}
+
+/// <summary>
+/// Gathers the properties the ranking is based on
+/// </summary>
+DeviceCandidate DeviceSelector::describe(VkPhysicalDevice device, uint32_t instanceApiVersion, const std::vector<const char*>& optionalExtensions) {
+	DeviceCandidate candidate;
+	candidate.device = device;
+	vkGetPhysicalDeviceProperties(device, &candidate.properties);
+
+	// The UUID needs vkGetPhysicalDeviceProperties2, which is core from 1.1 on both sides
+	if (instanceApiVersion >= VK_API_VERSION_1_1 && candidate.properties.apiVersion >= VK_API_VERSION_1_1) {
+		VkPhysicalDeviceIDProperties idProperties{};
+		idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+		VkPhysicalDeviceProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &idProperties;
+		vkGetPhysicalDeviceProperties2(device, &properties2);
+
+		std::ostringstream uuid;
+		uuid << std::hex << std::setfill('0');
+		for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+			uuid << std::setw(2) << static_cast<uint32_t>(idProperties.deviceUUID[i]);
+		}
+		candidate.uuid = uuid.str();
+	}
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+		if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+			candidate.deviceLocalBytes = std::max(candidate.deviceLocalBytes, memoryProperties.memoryHeaps[i].size);
+		}
+	}
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+	for (const auto& queueFamily : queueFamilies) {
+		bool graphics = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+		bool compute = queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT;
+		if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !graphics && !compute) {
+			candidate.dedicatedTransfer = true;
+		}
+		if (compute && !graphics) {
+			candidate.asyncCompute = true;
+		}
+	}
+
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const char* name : optionalExtensions) {
+		for (const auto& extension : availableExtensions) {
+			if (strcmp(extension.extensionName, name) == 0) {
+				candidate.optionalExtensions++;
+				break;
+			}
+		}
+	}
+
+	return candidate;
+}
+
+/// <summary>
+/// Scores a suitable device. The device type dominates, so a discrete GPU wins over an integrated one unless the probe
+/// measured it to be much slower. 8 GiB of device local memory weighs about as much as the queue families and extensions together
+/// </summary>
+uint64_t DeviceSelector::rate(const DeviceCandidate& candidate) {
+	uint64_t score = 1;
+
+	if (candidate.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
+		score += 10000;
+	}
+	else if (candidate.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU) {
+		score += 2000;
+	}
+
+	score += candidate.deviceLocalBytes >> 23; // 1 point per 8 MiB
+	score += candidate.dedicatedTransfer ? 500 : 0; // Uploads overlap rendering
+	score += candidate.asyncCompute ? 500 : 0; // Compute overlaps rendering
+	score += candidate.optionalExtensions * 250;
+	score += static_cast<uint64_t>(candidate.copyGBps * 20.0);
+
+	return score;
+}
+
+/// <summary>
+/// Measures the device local copy bandwidth with timestamps around PROBE_COPIES copies of PROBE_BYTES, on a throwaway logical device.
+/// Takes a few milliseconds per device
+/// </summary>
+/// <returns>GB/s read plus written, 0 when the device has no family with timestamps</returns>
+double DeviceSelector::probeCopyBandwidth(VkPhysicalDevice physicalDevice) {
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	// Graphics and compute families always support transfers, dedicated transfer families may lack timestamps
+	uint32_t family = queueFamilyCount;
+	for (uint32_t i = 0; i < queueFamilyCount; i++) {
+		if ((queueFamilies[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && queueFamilies[i].timestampValidBits > 0) {
+			family = i;
+			break;
+		}
+	}
+	if (family == queueFamilyCount) { return 0.0; }
+
+	float queuePriority = 1.0f;
+	VkDeviceQueueCreateInfo queueInfo{};
+	queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queueInfo.queueFamilyIndex = family;
+	queueInfo.queueCount = 1;
+	queueInfo.pQueuePriorities = &queuePriority;
+
+	VkDeviceCreateInfo deviceInfo{};
+	deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceInfo.queueCreateInfoCount = 1;
+	deviceInfo.pQueueCreateInfos = &queueInfo;
+
+	VkDevice device;
+	if (vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device) != VK_SUCCESS) { return 0.0; }
+
+	VkQueue queue;
+	vkGetDeviceQueue(device, family, 0, &queue);
+
+	GpuAllocator allocator;
+	allocator.init(device, physicalDevice);
+
+	// Everything is destroyed whether or not the probe gets through, a failure must not leak the temporary device
+	VkBuffer buffers[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+	GpuAllocation memory[2];
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+
+	auto destroyProbe = [&]() {
+		vkDeviceWaitIdle(device);
+		vkDestroyQueryPool(device, queryPool, nullptr);
+		vkDestroyCommandPool(device, commandPool, nullptr);
+		for (uint32_t i = 0; i < 2; i++) {
+			vkDestroyBuffer(device, buffers[i], nullptr);
+			allocator.free(memory[i]);
+		}
+		allocator.destroy();
+		vkDestroyDevice(device, nullptr);
+	};
+
+	double ns = 0.0;
+	try {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = PROBE_BYTES;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		for (uint32_t i = 0; i < 2; i++) {
+			// Created into a local, the handle a failed call leaves behind must not be destroyed
+			VkBuffer buffer;
+			if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create probe buffer!");
+			}
+			buffers[i] = buffer;
+			memory[i] = allocator.allocateBuffer(buffers[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = family;
+
+		VkCommandPool pool;
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create probe command pool!");
+		}
+		commandPool = pool;
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer comBuffer;
+		vkAllocateCommandBuffers(device, &allocInfo, &comBuffer);
+
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2;
+
+		VkQueryPool timestampPool;
+		if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestampPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create probe query pool!");
+		}
+		queryPool = timestampPool;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(comBuffer, &beginInfo);
+
+		vkCmdResetQueryPool(comBuffer, queryPool, 0, 2);
+
+		VkBufferCopy region{};
+		region.size = PROBE_BYTES;
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		// One untimed copy first, so the timed ones don't pay for first-touch page mapping
+		vkCmdCopyBuffer(comBuffer, buffers[0], buffers[1], 1, &region);
+		vkCmdPipelineBarrier(comBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		vkCmdWriteTimestamp(comBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, queryPool, 0);
+		for (uint32_t i = 0; i < PROBE_COPIES; i++) {
+			// Back and forth, each copy reads what the previous one wrote
+			vkCmdCopyBuffer(comBuffer, buffers[(i + 1) % 2], buffers[i % 2], 1, &region);
+			vkCmdPipelineBarrier(comBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+		vkCmdWriteTimestamp(comBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, queryPool, 1);
+
+		vkEndCommandBuffer(comBuffer);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &comBuffer;
+
+		if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit the probe!");
+		}
+		vkQueueWaitIdle(queue);
+
+		uint64_t timestamps[2] = {};
+		vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+		uint32_t validBits = queueFamilies[family].timestampValidBits;
+		uint64_t mask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+		ns = static_cast<double>((timestamps[1] - timestamps[0]) & mask) * properties.limits.timestampPeriod;
+	}
+	catch (...) {
+		destroyProbe();
+		throw;
+	}
+
+	destroyProbe();
+
+	// Every copy reads and writes PROBE_BYTES, bytes per ns is GB/s
+	return ns > 0.0 ? 2.0 * PROBE_BYTES * PROBE_COPIES / ns : 0.0;
+}
+
+/// <summary>
+/// Lower case hex digits only, so UUIDs can be given with dashes and in either case
+/// </summary>
+std::string DeviceSelector::normalizeUuid(const std::string& uuid) {
+	std::string normalized;
+	for (char c : uuid) {
+		if (std::isxdigit(static_cast<unsigned char>(c))) {
+			normalized += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		}
+	}
+	return normalized;
+}
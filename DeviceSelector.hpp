@@ -0,0 +1,54 @@
+#ifndef DEVICESELECTOR_H
+#define DEVICESELECTOR_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// What the selector found out about a physical device
+/// </summary>
+struct DeviceCandidate {
+	VkPhysicalDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties properties{};
+	std::string uuid; // deviceUUID as 32 hex digits, empty when the instance or device is older than 1.1
+
+	VkDeviceSize deviceLocalBytes = 0; // Size of the largest device local heap
+	bool dedicatedTransfer = false; // Has a transfer family without graphics or compute
+	bool asyncCompute = false; // Has a compute family without graphics
+	uint32_t optionalExtensions = 0; // How many of the optional extensions it supports
+	double copyGBps = 0.0; // Device local copy bandwidth measured by the probe, 0 when not probed
+
+	std::string rejection; // Why the device can't be used, empty when it's suitable
+	uint64_t score = 0;
+};
+
+/// <summary>
+/// Picks the physical device to use. Devices failing the app's requirements are rejected, the rest are ranked by device type,
+/// device local memory, queue family topology, optional extensions and optionally a short copy benchmark.
+/// A device can be pinned by its UUID, which overrides the ranking
+/// </summary>
+class DeviceSelector {
+public:
+	// Returns why the device can't be used, or an empty string when it meets every requirement
+	using RequirementCheck = std::function<std::string(VkPhysicalDevice)>;
+
+	VkPhysicalDevice select(VkInstance instance, uint32_t instanceApiVersion, const RequirementCheck& check,
+		const std::vector<const char*>& optionalExtensions, const std::string& pinnedUuid, bool probe);
+
+	const std::vector<DeviceCandidate>& getCandidates() const;
+	void printCandidates(const DeviceCandidate* chosen) const;
+
+private:
+	std::vector<DeviceCandidate> candidates;
+
+	DeviceCandidate describe(VkPhysicalDevice device, uint32_t instanceApiVersion, const std::vector<const char*>& optionalExtensions);
+	static uint64_t rate(const DeviceCandidate& candidate);
+	static double probeCopyBandwidth(VkPhysicalDevice device);
+	static std::string normalizeUuid(const std::string& uuid);
+};
+
+#endif // !DEVICESELECTOR_H
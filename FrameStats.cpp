@@ -0,0 +1,61 @@
+#include "FrameStats.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+void FrameStats::reset() {
+	frameTimes.clear();
+	total = 0.0;
+}
+
+/// <summary>
+/// Records the duration of a single frame
+/// </summary>
+/// <param name="frameSeconds">Time between the start of this frame and the start of the previous one</param>
+void FrameStats::addFrame(double frameSeconds) {
+	frameTimes.push_back(frameSeconds);
+	total += frameSeconds;
+}
+
+size_t FrameStats::frameCount() const {
+	return frameTimes.size();
+}
+
+double FrameStats::totalSeconds() const {
+	return total;
+}
+
+double FrameStats::averageFps() const {
+	return total > 0.0 ? static_cast<double>(frameTimes.size()) / total : 0.0;
+}
+
+double FrameStats::averageMs() const {
+	return frameTimes.empty() ? 0.0 : total * 1000.0 / static_cast<double>(frameTimes.size());
+}
+
+/// <summary>
+/// Gets the frame time that the given percentage of frames stay below
+/// </summary>
+/// <param name="percentile">Percentile in the range [0, 100]</param>
+/// <returns>The frame time in milliseconds</returns>
+double FrameStats::percentileMs(double percentile) const {
+	if (frameTimes.empty()) { return 0.0; }
+
+	std::vector<double> sorted(frameTimes);
+	size_t index = static_cast<size_t>(std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(sorted.size() - 1));
+	std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+
+	return sorted[index] * 1000.0;
+}
+
+double FrameStats::maxMs() const {
+	if (frameTimes.empty()) { return 0.0; }
+	return *std::max_element(frameTimes.begin(), frameTimes.end()) * 1000.0;
+}
+
+void FrameStats::print(const char* label) const {
+	std::cout << label << ": " << frameCount() << " frames in " << totalSeconds() << " s"
+		<< " | avg " << averageFps() << " fps (" << averageMs() << " ms)"
+		<< " | p99 " << percentileMs(99.0) << " ms"
+		<< " | max " << maxMs() << " ms\n";
+}
\ No newline at end of file
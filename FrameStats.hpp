@@ -0,0 +1,29 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <vector>
+#include <cstddef>
+
+/// <summary>
+/// Collects frame times so throughput (fps) and frame pacing can be compared between runs
+/// </summary>
+class FrameStats {
+public:
+	void reset();
+	void addFrame(double frameSeconds);
+
+	size_t frameCount() const;
+	double totalSeconds() const;
+	double averageFps() const;
+	double averageMs() const;
+	double percentileMs(double percentile) const;
+	double maxMs() const;
+
+	void print(const char* label) const;
+
+private:
+	std::vector<double> frameTimes;
+	double total = 0.0;
+};
+
+#endif // !FRAMESTATS_H
@@ -0,0 +1,293 @@
+#include "FrustumCuller.hpp"
+
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRUSTUMCULLER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2,popcnt")))
+#endif
+#endif
+
+#ifdef FRUSTUMCULLER_X86
+namespace {
+	// For every 8 bit visibility mask, the visible lanes packed as 4 bit indices from the lowest nibble up
+	constexpr std::array<uint32_t, 256> makeCompactLanes() {
+		std::array<uint32_t, 256> table{};
+		for (uint32_t mask = 0; mask < 256; mask++) {
+			uint32_t slot = 0;
+			for (uint32_t lane = 0; lane < 8; lane++) {
+				if (mask & (1u << lane)) {
+					table[mask] |= lane << (4 * slot++);
+				}
+			}
+		}
+		return table;
+	}
+	constexpr std::array<uint32_t, 256> COMPACT_LANES = makeCompactLanes();
+
+	bool cpuHasAvx2() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) { return false; }
+
+		// The OS must also save the YMM registers on context switches
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) { return false; }
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+#endif
+	}
+}
+#endif
+
+void FrustumCuller::clear() {
+	sphereCount = 0;
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	radius.clear();
+	visible.clear();
+}
+
+void FrustumCuller::reserve(uint32_t count) {
+	size_t padded = (static_cast<size_t>(count) + LANES - 1) / LANES * LANES;
+	centerX.reserve(padded);
+	centerY.reserve(padded);
+	centerZ.reserve(padded);
+	radius.reserve(padded);
+	visible.reserve(padded);
+}
+
+void FrustumCuller::add(glm::vec3 center, float sphereRadius) {
+	if (sphereCount == centerX.size()) {
+		// The padding spheres have a negative infinite radius, which fails every plane
+		size_t padded = centerX.size() + LANES;
+		centerX.resize(padded, 0.0f);
+		centerY.resize(padded, 0.0f);
+		centerZ.resize(padded, 0.0f);
+		radius.resize(padded, -std::numeric_limits<float>::infinity());
+		visible.resize(padded);
+	}
+
+	centerX[sphereCount] = center.x;
+	centerY[sphereCount] = center.y;
+	centerZ[sphereCount] = center.z;
+	radius[sphereCount] = sphereRadius;
+	sphereCount++;
+}
+
+/// <summary>
+/// Gets the planes from the rows of the matrix (Gribb & Hartmann), a point p is inside when dot(plane.xyz, p) + plane.w >= 0.
+/// With the normals normalized that is the signed distance, so a sphere is outside once it drops below -radius
+/// </summary>
+std::array<glm::vec4, 6> FrustumCuller::extractPlanes(const glm::mat4& viewProjection) {
+	const glm::mat4& m = viewProjection;
+	glm::vec4 row0(m[0].x, m[1].x, m[2].x, m[3].x);
+	glm::vec4 row1(m[0].y, m[1].y, m[2].y, m[3].y);
+	glm::vec4 row2(m[0].z, m[1].z, m[2].z, m[3].z);
+	glm::vec4 row3(m[0].w, m[1].w, m[2].w, m[3].w);
+
+	std::array<glm::vec4, 6> planes = {
+		row3 + row0, // Left
+		row3 - row0, // Right
+		row3 + row1, // Bottom
+		row3 - row1, // Top
+		row2, // Near, the clip depth starts at 0 in Vulkan
+		row3 - row2 // Far
+	};
+
+	for (auto& plane : planes) {
+		float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		if (length > 0.0f) {
+			plane = plane / length;
+		}
+	}
+
+	return planes;
+}
+
+std::span<const uint32_t> FrustumCuller::cull(const glm::mat4& viewProjection) {
+	std::array<glm::vec4, 6> planes = extractPlanes(viewProjection);
+
+	uint32_t visibleCount = 0;
+	switch (kernel) {
+	case CullKernel::Avx2:
+		visibleCount = cullAvx2(planes, visible.data());
+		break;
+	case CullKernel::Sse:
+		visibleCount = cullSse(planes, visible.data());
+		break;
+	default:
+		visibleCount = cullScalar(planes, visible.data());
+		break;
+	}
+
+	return { visible.data(), visibleCount };
+}
+
+bool FrustumCuller::isSupported(CullKernel kernel) {
+	switch (kernel) {
+#ifdef FRUSTUMCULLER_X86
+	case CullKernel::Sse:
+		return true; // Part of every x86-64 CPU, and the 32 bit builds target SSE2
+	case CullKernel::Avx2: {
+		static const bool avx2 = cpuHasAvx2();
+		return avx2;
+	}
+#endif
+	case CullKernel::Scalar:
+		return true;
+	default:
+		return false;
+	}
+}
+
+CullKernel FrustumCuller::bestKernel() {
+	if (isSupported(CullKernel::Avx2)) { return CullKernel::Avx2; }
+	if (isSupported(CullKernel::Sse)) { return CullKernel::Sse; }
+	return CullKernel::Scalar;
+}
+
+const char* FrustumCuller::kernelName(CullKernel kernel) {
+	switch (kernel) {
+	case CullKernel::Sse: return "SSE";
+	case CullKernel::Avx2: return "AVX2";
+	default: return "scalar";
+	}
+}
+
+void FrustumCuller::setKernel(CullKernel kernel) {
+	if (!isSupported(kernel)) {
+		throw std::runtime_error(std::string("The CPU doesn't support the ") + kernelName(kernel) + " culling kernel!");
+	}
+
+	this->kernel = kernel;
+}
+
+/// <summary>
+/// The reference the SIMD kernels must match, the plane distances are summed in the same order
+/// </summary>
+uint32_t FrustumCuller::cullScalar(const std::array<glm::vec4, 6>& planes, uint32_t* out) const {
+	uint32_t visibleCount = 0;
+
+	for (uint32_t i = 0; i < sphereCount; i++) {
+		bool inside = true;
+		for (const auto& plane : planes) {
+			float distance = centerX[i] * plane.x + centerY[i] * plane.y + centerZ[i] * plane.z + plane.w;
+			inside &= distance >= -radius[i];
+		}
+
+		out[visibleCount] = i;
+		visibleCount += inside ? 1 : 0;
+	}
+
+	return visibleCount;
+}
+
+#ifdef FRUSTUMCULLER_X86
+
+/// <summary>
+/// 4 spheres per iteration, the visible lanes are compacted one by one without branching
+/// </summary>
+uint32_t FrustumCuller::cullSse(const std::array<glm::vec4, 6>& planes, uint32_t* out) const {
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (size_t p = 0; p < planes.size(); p++) {
+		planeX[p] = _mm_set1_ps(planes[p].x);
+		planeY[p] = _mm_set1_ps(planes[p].y);
+		planeZ[p] = _mm_set1_ps(planes[p].z);
+		planeW[p] = _mm_set1_ps(planes[p].w);
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	uint32_t visibleCount = 0;
+	uint32_t paddedCount = static_cast<uint32_t>(centerX.size());
+
+	for (uint32_t i = 0; i < paddedCount; i += 4) {
+		__m128 x = _mm_loadu_ps(&centerX[i]);
+		__m128 y = _mm_loadu_ps(&centerY[i]);
+		__m128 z = _mm_loadu_ps(&centerZ[i]);
+		__m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(&radius[i]));
+
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planeX[p]), _mm_mul_ps(y, planeY[p])), _mm_mul_ps(z, planeZ[p])), planeW[p]);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+		}
+
+		uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+		for (uint32_t lane = 0; lane < 4; lane++) {
+			out[visibleCount] = i + lane;
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+
+	return visibleCount;
+}
+
+/// <summary>
+/// 8 spheres per iteration, the visible lanes' indices are unpacked from a table by the mask and stored together.
+/// The store may write past the visible ones, which the padded output array has room for
+/// </summary>
+AVX2_FUNCTION uint32_t FrustumCuller::cullAvx2(const std::array<glm::vec4, 6>& planes, uint32_t* out) const {
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (size_t p = 0; p < planes.size(); p++) {
+		planeX[p] = _mm256_set1_ps(planes[p].x);
+		planeY[p] = _mm256_set1_ps(planes[p].y);
+		planeZ[p] = _mm256_set1_ps(planes[p].z);
+		planeW[p] = _mm256_set1_ps(planes[p].w);
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256i nibbleShifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+	const __m256i nibbleMask = _mm256_set1_epi32(0xF);
+	uint32_t visibleCount = 0;
+	uint32_t paddedCount = static_cast<uint32_t>(centerX.size());
+
+	for (uint32_t i = 0; i < paddedCount; i += 8) {
+		__m256 x = _mm256_loadu_ps(&centerX[i]);
+		__m256 y = _mm256_loadu_ps(&centerY[i]);
+		__m256 z = _mm256_loadu_ps(&centerZ[i]);
+		__m256 negRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(&radius[i]));
+
+		__m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+		for (int p = 0; p < 6; p++) {
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, planeX[p]), _mm256_mul_ps(y, planeY[p])), _mm256_mul_ps(z, planeZ[p])), planeW[p]);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+		}
+
+		uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+		__m256i lanes = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(COMPACT_LANES[mask])), nibbleShifts), nibbleMask);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + visibleCount), _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(i))));
+		visibleCount += std::popcount(mask);
+	}
+
+	return visibleCount;
+}
+
+#else
+
+// Never picked, isSupported only reports the scalar kernel
+uint32_t FrustumCuller::cullSse(const std::array<glm::vec4, 6>& planes, uint32_t* out) const {
+	return cullScalar(planes, out);
+}
+
+uint32_t FrustumCuller::cullAvx2(const std::array<glm::vec4, 6>& planes, uint32_t* out) const {
+	return cullScalar(planes, out);
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef FRUSTUMCULLER_H
+#define FRUSTUMCULLER_H
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/// <summary>
+/// Which implementation tests the spheres, the best one the CPU supports is picked at runtime
+/// </summary>
+enum class CullKernel {
+	Scalar,
+	Sse, // 4 spheres at a time
+	Avx2 // 8 spheres at a time
+};
+
+/// <summary>
+/// CPU frustum culling of bounding spheres kept as structure-of-arrays, so a SIMD kernel loads the same coordinate of
+/// 4 or 8 spheres with one instruction and tests them against the six planes together.
+/// The result is a compact list of the indices of the visible spheres, in increasing order.
+/// Not thread safe, it's meant to be driven by the main thread before recording
+/// </summary>
+class FrustumCuller {
+public:
+	// Every array is padded to a multiple of this, so the kernels never need a scalar tail
+	static constexpr uint32_t LANES = 8;
+
+	void clear();
+	void reserve(uint32_t count);
+	void add(glm::vec3 center, float radius);
+	uint32_t count() const { return sphereCount; }
+
+	// The planes of viewProjection's clip volume (Vulkan depth, 0 to w), normalized and pointing inwards
+	static std::array<glm::vec4, 6> extractPlanes(const glm::mat4& viewProjection);
+
+	// The indices of the spheres inside or touching the frustum, valid until the next cull or add
+	std::span<const uint32_t> cull(const glm::mat4& viewProjection);
+
+	static bool isSupported(CullKernel kernel);
+	static CullKernel bestKernel();
+	static const char* kernelName(CullKernel kernel);
+
+	CullKernel getKernel() const { return kernel; }
+	void setKernel(CullKernel kernel);
+
+private:
+	CullKernel kernel = bestKernel();
+
+	uint32_t sphereCount = 0;
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radius;
+	std::vector<uint32_t> visible; // As long as the padded arrays, the kernels store whole batches of indices
+
+	uint32_t cullScalar(const std::array<glm::vec4, 6>& planes, uint32_t* out) const;
+	uint32_t cullSse(const std::array<glm::vec4, 6>& planes, uint32_t* out) const;
+	uint32_t cullAvx2(const std::array<glm::vec4, 6>& planes, uint32_t* out) const;
+};
+
+#endif // !FRUSTUMCULLER_H
@@ -0,0 +1,426 @@
+#include "GpuAllocator.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+// Blocks are this big unless the heap is small, allocations above half a block get their own VkDeviceMemory
+const VkDeviceSize DEVICE_BLOCK_SIZE = 64ull << 20;
+const VkDeviceSize HOST_BLOCK_SIZE = 16ull << 20;
+
+static VkDeviceSize nextPowerOfTwo(VkDeviceSize value) {
+	VkDeviceSize result = 1;
+	while (result < value) {
+		result <<= 1;
+	}
+	return result;
+}
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+/// <param name="blockSize">Size of the whole block, rounded down to a power of two</param>
+/// <param name="minNodeSize">Smallest node handed out, smaller requests are padded up to it</param>
+BuddySubAllocator::BuddySubAllocator(VkDeviceSize blockSize, VkDeviceSize minNodeSize) : minNodeSize(minNodeSize) {
+	VkDeviceSize rootSize = nextPowerOfTwo(blockSize);
+	if (rootSize > blockSize) {
+		rootSize >>= 1;
+	}
+
+	maxOrder = 0;
+	while ((minNodeSize << maxOrder) < rootSize) {
+		maxOrder++;
+	}
+
+	freeTotal = minNodeSize << maxOrder;
+	freeLists.resize(maxOrder + 1);
+	freeLists[maxOrder].insert(0);
+}
+
+std::optional<VkDeviceSize> BuddySubAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+	VkDeviceSize nodeSize = nextPowerOfTwo(std::max({ size, alignment, minNodeSize }));
+
+	uint32_t order = 0;
+	while ((minNodeSize << order) < nodeSize) {
+		order++;
+	}
+	if (order > maxOrder) { return std::nullopt; }
+
+	// Take the smallest free node that fits and split it down to the wanted order
+	uint32_t found = order;
+	while (found <= maxOrder && freeLists[found].empty()) {
+		found++;
+	}
+	if (found > maxOrder) { return std::nullopt; }
+
+	VkDeviceSize offset = *freeLists[found].begin();
+	freeLists[found].erase(freeLists[found].begin());
+
+	while (found > order) {
+		found--;
+		freeLists[found].insert(offset + (minNodeSize << found));
+	}
+
+	allocatedOrders[offset] = order;
+	freeTotal -= minNodeSize << order;
+
+	return offset;
+}
+
+void BuddySubAllocator::free(VkDeviceSize offset) {
+	auto it = allocatedOrders.find(offset);
+	if (it == allocatedOrders.end()) {
+		throw std::runtime_error("Freeing an offset that wasn't allocated from this block!");
+	}
+
+	uint32_t order = it->second;
+	allocatedOrders.erase(it);
+	freeTotal += minNodeSize << order;
+
+	// Merge with the buddy for as long as it is free too
+	while (order < maxOrder) {
+		VkDeviceSize buddy = offset ^ (minNodeSize << order);
+		if (freeLists[order].erase(buddy) == 0) {
+			break;
+		}
+
+		offset = std::min(offset, buddy);
+		order++;
+	}
+
+	freeLists[order].insert(offset);
+}
+
+bool BuddySubAllocator::empty() const {
+	return allocatedOrders.empty();
+}
+
+VkDeviceSize BuddySubAllocator::freeBytes() const {
+	return freeTotal;
+}
+
+VkDeviceSize BuddySubAllocator::largestFreeRange() const {
+	for (uint32_t order = maxOrder + 1; order-- > 0;) {
+		if (!freeLists[order].empty()) {
+			return minNodeSize << order;
+		}
+	}
+	return 0;
+}
+
+LinearSubAllocator::LinearSubAllocator(VkDeviceSize blockSize) : blockSize(blockSize) {}
+
+std::optional<VkDeviceSize> LinearSubAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+	VkDeviceSize offset = alignUp(head, std::max<VkDeviceSize>(alignment, 1));
+	if (offset + size > blockSize) { return std::nullopt; }
+
+	head = offset + size;
+	liveAllocations++;
+
+	return offset;
+}
+
+void LinearSubAllocator::free(VkDeviceSize offset) {
+	if (liveAllocations == 0) {
+		throw std::runtime_error("Freeing from an empty linear block!");
+	}
+
+	if (--liveAllocations == 0) {
+		head = 0;
+	}
+}
+
+bool LinearSubAllocator::empty() const {
+	return liveAllocations == 0;
+}
+
+VkDeviceSize LinearSubAllocator::freeBytes() const {
+	return blockSize - head;
+}
+
+VkDeviceSize LinearSubAllocator::largestFreeRange() const {
+	return blockSize - head;
+}
+
+void GpuAllocator::init(VkDevice device, VkPhysicalDevice physicalDevice) {
+	this->device = device;
+
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	bufferImageGranularity = properties.limits.bufferImageGranularity;
+}
+
+/// <summary>
+/// Frees every block and dedicated allocation, the resources placed in them must already be destroyed
+/// </summary>
+void GpuAllocator::destroy() {
+	for (auto& [key, pool] : pools) {
+		for (auto& block : pool.blocks) {
+			if (block.memory != VK_NULL_HANDLE) {
+				releaseMemory(block.memory);
+			}
+		}
+	}
+
+	for (auto& [memory, size] : dedicatedAllocations) {
+		releaseMemory(memory);
+	}
+
+	pools.clear();
+	dedicatedAllocations.clear();
+	allocationCount = 0;
+	bytesUsed = 0;
+}
+
+/// <summary>
+/// Sub-allocates memory fulfilling the requirements from a block of a matching memory type, creating a new block when none has room
+/// </summary>
+/// <param name="properties">The required memory properties, host visible memory comes back mapped</param>
+/// <param name="kind">Linear for buffers and linear images, Optimal for optimally tiled images</param>
+/// <param name="strategy">How the allocation is placed inside its block</param>
+GpuAllocation GpuAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+	GpuResourceKind kind, AllocationStrategy strategy) {
+	uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+	uint32_t key = poolKey(memoryType, kind, strategy);
+
+	GpuAllocation allocation;
+	allocation.size = requirements.size;
+	allocation.pool = key;
+
+	Pool& pool = pools[key];
+	if (pool.blockSize == 0) {
+		pool.memoryType = memoryType;
+		pool.strategy = strategy;
+		pool.blockSize = preferredBlockSize(memoryType);
+	}
+
+	if (requirements.size > pool.blockSize / 2) {
+		void* mapped = nullptr;
+		allocation.memory = allocateMemory(requirements.size, memoryType, &mapped);
+		allocation.mapped = mapped;
+		allocation.block = DEDICATED_BLOCK;
+
+		dedicatedAllocations[allocation.memory] = requirements.size;
+		allocationCount++;
+		bytesUsed += requirements.size;
+
+		return allocation;
+	}
+
+	auto place = [&](uint32_t blockIndex) {
+		Block& block = pool.blocks[blockIndex];
+		if (block.memory == VK_NULL_HANDLE) { return false; }
+
+		auto offset = block.allocator->allocate(requirements.size, requirements.alignment);
+		if (!offset) { return false; }
+
+		allocation.memory = block.memory;
+		allocation.offset = *offset;
+		allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + *offset : nullptr;
+		allocation.block = blockIndex;
+		return true;
+	};
+
+	bool placed = false;
+	for (uint32_t i = 0; i < pool.blocks.size() && !placed; i++) {
+		placed = place(i);
+	}
+
+	if (!placed) {
+		// Reuse the slot of a released block if there is one
+		uint32_t blockIndex = static_cast<uint32_t>(pool.blocks.size());
+		for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+			if (pool.blocks[i].memory == VK_NULL_HANDLE) {
+				blockIndex = i;
+				break;
+			}
+		}
+		if (blockIndex == pool.blocks.size()) {
+			pool.blocks.emplace_back();
+		}
+
+		Block& block = pool.blocks[blockIndex];
+		block.memory = allocateMemory(pool.blockSize, memoryType, &block.mapped);
+		if (strategy == AllocationStrategy::Linear) {
+			block.allocator = std::make_unique<LinearSubAllocator>(pool.blockSize);
+		}
+		else {
+			block.allocator = std::make_unique<BuddySubAllocator>(pool.blockSize);
+		}
+
+		if (!place(blockIndex)) {
+			throw std::runtime_error("Allocation doesn't fit in an empty memory block!");
+		}
+	}
+
+	allocationCount++;
+	bytesUsed += requirements.size;
+
+	return allocation;
+}
+
+/// <summary>
+/// Allocates memory for the buffer and binds it
+/// </summary>
+GpuAllocation GpuAllocator::allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, AllocationStrategy strategy) {
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, buffer, &requirements);
+
+	GpuAllocation allocation = allocate(requirements, properties, GpuResourceKind::Linear, strategy);
+	vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+
+	return allocation;
+}
+
+/// <summary>
+/// Allocates memory for the image and binds it
+/// </summary>
+/// <param name="tiling">The tiling the image was created with, decides which blocks it may share</param>
+GpuAllocation GpuAllocator::allocateImage(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling) {
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device, image, &requirements);
+
+	GpuResourceKind kind = tiling == VK_IMAGE_TILING_OPTIMAL ? GpuResourceKind::Optimal : GpuResourceKind::Linear;
+	GpuAllocation allocation = allocate(requirements, properties, kind);
+	vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+
+	return allocation;
+}
+
+/// <summary>
+/// Returns the allocation to its block and resets it. Blocks that become empty are given back to the driver, except the first one of each pool
+/// </summary>
+void GpuAllocator::free(GpuAllocation& allocation) {
+	if (!allocation.isValid()) { return; }
+
+	if (allocation.block == DEDICATED_BLOCK) {
+		dedicatedAllocations.erase(allocation.memory);
+		releaseMemory(allocation.memory);
+	}
+	else {
+		Pool& pool = pools.at(allocation.pool);
+		Block& block = pool.blocks[allocation.block];
+		block.allocator->free(allocation.offset);
+
+		if (block.allocator->empty() && allocation.block != 0) {
+			releaseMemory(block.memory);
+			block.memory = VK_NULL_HANDLE;
+			block.mapped = nullptr;
+			block.allocator.reset();
+		}
+	}
+
+	allocationCount--;
+	bytesUsed -= allocation.size;
+	allocation = GpuAllocation{};
+}
+
+/// <summary>
+/// Finds a memory type that is allowed by the resource and has all the wanted properties
+/// </summary>
+/// <param name="typeFilter">Bitmask of allowed memory types, from VkMemoryRequirements</param>
+/// <param name="properties">The required memory properties</param>
+/// <returns>The index of the memory type</returns>
+uint32_t GpuAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Failed to find a suitable memory type!");
+}
+
+GpuAllocatorStats GpuAllocator::stats() const {
+	GpuAllocatorStats result;
+	result.allocationCount = allocationCount;
+	result.bytesUsed = bytesUsed;
+
+	for (const auto& [key, pool] : pools) {
+		for (const auto& block : pool.blocks) {
+			if (block.memory == VK_NULL_HANDLE) { continue; }
+
+			result.blockCount++;
+			result.bytesReserved += pool.blockSize;
+			result.bytesFree += block.allocator->freeBytes();
+			result.largestFreeRange = std::max(result.largestFreeRange, block.allocator->largestFreeRange());
+		}
+	}
+
+	for (const auto& [memory, size] : dedicatedAllocations) {
+		result.dedicatedCount++;
+		result.bytesReserved += size;
+	}
+
+	if (result.bytesFree > 0) {
+		result.fragmentation = 1.0 - static_cast<double>(result.largestFreeRange) / static_cast<double>(result.bytesFree);
+	}
+
+	return result;
+}
+
+void GpuAllocator::printStats(const char* label) const {
+	GpuAllocatorStats s = stats();
+	std::cout << label << ": " << s.allocationCount << " allocations in " << s.blockCount << " blocks + " << s.dedicatedCount << " dedicated"
+		<< " | used " << s.bytesUsed / 1024 << " / " << s.bytesReserved / 1024 << " KiB"
+		<< " | largest free " << s.largestFreeRange / 1024 << " KiB"
+		<< " | fragmentation " << s.fragmentation * 100.0 << " %\n";
+}
+
+/// <summary>
+/// Buffers and linear images get their own pools apart from optimal images when the device has a bufferImageGranularity above 1
+/// </summary>
+uint32_t GpuAllocator::poolKey(uint32_t memoryType, GpuResourceKind kind, AllocationStrategy strategy) const {
+	uint32_t optimal = (kind == GpuResourceKind::Optimal && bufferImageGranularity > 1) ? 1 : 0;
+	uint32_t linear = strategy == AllocationStrategy::Linear ? 1 : 0;
+	return memoryType << 2 | optimal << 1 | linear;
+}
+
+/// <summary>
+/// Uses the default block size, unless it's more than an eighth of the memory type's heap
+/// </summary>
+VkDeviceSize GpuAllocator::preferredBlockSize(uint32_t memoryType) const {
+	const VkMemoryType& type = memoryProperties.memoryTypes[memoryType];
+	VkDeviceSize heapSize = memoryProperties.memoryHeaps[type.heapIndex].size;
+
+	VkDeviceSize blockSize = (type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? HOST_BLOCK_SIZE : DEVICE_BLOCK_SIZE;
+	while (blockSize > heapSize / 8 && blockSize > (1ull << 20)) {
+		blockSize >>= 1;
+	}
+
+	return blockSize;
+}
+
+/// <summary>
+/// Allocates memory straight from the driver, host visible memory is mapped right away and stays mapped
+/// </summary>
+VkDeviceMemory GpuAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryType, void** mapped) {
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate device memory!");
+	}
+
+	*mapped = nullptr;
+	if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to map device memory!");
+		}
+	}
+
+	return memory;
+}
+
+/// <summary>
+/// Gives memory back to the driver, freeing mapped memory unmaps it implicitly
+/// </summary>
+void GpuAllocator::releaseMemory(VkDeviceMemory memory) {
+	vkFreeMemory(device, memory, nullptr);
+}
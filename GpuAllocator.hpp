@@ -0,0 +1,168 @@
+#ifndef GPUALLOCATOR_H
+#define GPUALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// How allocations are placed inside a memory block.
+/// Buddy handles any mix of lifetimes, Linear is a bump allocator for short lived data (e.g. staging) that rewinds once the block is empty
+/// </summary>
+enum class AllocationStrategy {
+	Buddy,
+	Linear
+};
+
+/// <summary>
+/// Whether the resource is a buffer/linear image or an optimally tiled image.
+/// The two kinds never share a block, so bufferImageGranularity can't be violated
+/// </summary>
+enum class GpuResourceKind {
+	Linear,
+	Optimal
+};
+
+/// <summary>
+/// A range of device memory handed out by the GpuAllocator
+/// </summary>
+struct GpuAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr; // Points at offset when the memory is host visible, blocks stay mapped for their whole lifetime
+
+	uint32_t pool = 0;
+	uint32_t block = 0; // DEDICATED_BLOCK when the allocation owns its VkDeviceMemory
+
+	bool isValid() const { return memory != VK_NULL_HANDLE; }
+};
+
+struct GpuAllocatorStats {
+	uint32_t blockCount = 0;
+	uint32_t dedicatedCount = 0;
+	uint64_t allocationCount = 0;
+	VkDeviceSize bytesReserved = 0; // Everything allocated from the driver
+	VkDeviceSize bytesUsed = 0; // Requested by the allocations, without padding
+	VkDeviceSize bytesFree = 0;
+	VkDeviceSize largestFreeRange = 0;
+	double fragmentation = 0.0; // 1 - largestFreeRange / bytesFree, 0 when all free memory is in one range
+};
+
+/// <summary>
+/// Places allocations inside a single block, only deals with offsets so it can be used and benchmarked without a device
+/// </summary>
+class SubAllocator {
+public:
+	virtual ~SubAllocator() = default;
+
+	virtual std::optional<VkDeviceSize> allocate(VkDeviceSize size, VkDeviceSize alignment) = 0;
+	virtual void free(VkDeviceSize offset) = 0;
+
+	virtual bool empty() const = 0;
+	virtual VkDeviceSize freeBytes() const = 0;
+	virtual VkDeviceSize largestFreeRange() const = 0;
+};
+
+/// <summary>
+/// Power of two buddy allocator, every node is aligned to its own size so any power of two alignment up to the node size comes for free
+/// </summary>
+class BuddySubAllocator : public SubAllocator {
+public:
+	BuddySubAllocator(VkDeviceSize blockSize, VkDeviceSize minNodeSize = 256);
+
+	std::optional<VkDeviceSize> allocate(VkDeviceSize size, VkDeviceSize alignment) override;
+	void free(VkDeviceSize offset) override;
+
+	bool empty() const override;
+	VkDeviceSize freeBytes() const override;
+	VkDeviceSize largestFreeRange() const override;
+
+private:
+	VkDeviceSize minNodeSize;
+	uint32_t maxOrder;
+	VkDeviceSize freeTotal;
+
+	std::vector<std::set<VkDeviceSize>> freeLists; // Free node offsets per order, a node of order n is minNodeSize << n bytes
+	std::unordered_map<VkDeviceSize, uint32_t> allocatedOrders;
+};
+
+/// <summary>
+/// Bump allocator, frees only count the live allocations and the block rewinds when the last one is gone
+/// </summary>
+class LinearSubAllocator : public SubAllocator {
+public:
+	explicit LinearSubAllocator(VkDeviceSize blockSize);
+
+	std::optional<VkDeviceSize> allocate(VkDeviceSize size, VkDeviceSize alignment) override;
+	void free(VkDeviceSize offset) override;
+
+	bool empty() const override;
+	VkDeviceSize freeBytes() const override;
+	VkDeviceSize largestFreeRange() const override;
+
+private:
+	VkDeviceSize blockSize;
+	VkDeviceSize head = 0;
+	uint32_t liveAllocations = 0;
+};
+
+/// <summary>
+/// Grabs large VkDeviceMemory blocks per memory type and sub-allocates resources from them,
+/// so the number of vkAllocateMemory calls stays far below maxMemoryAllocationCount
+/// </summary>
+class GpuAllocator {
+public:
+	static constexpr uint32_t DEDICATED_BLOCK = UINT32_MAX;
+
+	void init(VkDevice device, VkPhysicalDevice physicalDevice);
+	void destroy();
+
+	GpuAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+		GpuResourceKind kind = GpuResourceKind::Linear, AllocationStrategy strategy = AllocationStrategy::Buddy);
+	GpuAllocation allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, AllocationStrategy strategy = AllocationStrategy::Buddy);
+	GpuAllocation allocateImage(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL);
+	void free(GpuAllocation& allocation);
+
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	GpuAllocatorStats stats() const;
+	void printStats(const char* label) const;
+
+private:
+	struct Block {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mapped = nullptr;
+		std::unique_ptr<SubAllocator> allocator;
+	};
+
+	struct Pool {
+		uint32_t memoryType = 0;
+		AllocationStrategy strategy = AllocationStrategy::Buddy;
+		VkDeviceSize blockSize = 0;
+		std::vector<Block> blocks; // Released blocks keep their slot with a null memory handle
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	VkDeviceSize bufferImageGranularity = 1;
+
+	std::map<uint32_t, Pool> pools; // Keyed by memory type, resource kind and strategy, see poolKey
+	std::unordered_map<VkDeviceMemory, VkDeviceSize> dedicatedAllocations;
+
+	uint64_t allocationCount = 0;
+	VkDeviceSize bytesUsed = 0;
+
+	uint32_t poolKey(uint32_t memoryType, GpuResourceKind kind, AllocationStrategy strategy) const;
+	VkDeviceSize preferredBlockSize(uint32_t memoryType) const;
+	VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t memoryType, void** mapped);
+	void releaseMemory(VkDeviceMemory memory);
+};
+
+#endif // !GPUALLOCATOR_H
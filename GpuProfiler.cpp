@@ -0,0 +1,265 @@
+#include "GpuProfiler.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+/// <summary>
+/// Creates a timestamp query pool (and a pipeline statistics pool if requested) per frame slot.
+/// The profiler stays disabled when the queue family doesn't support timestamps
+/// </summary>
+/// <param name="queueFamily">The family of the queue the profiled command buffers are submitted to</param>
+/// <param name="frameSlots">Number of frames in flight</param>
+/// <param name="pipelineStatistics">Whether the pipelineStatisticsQuery feature was enabled on the device</param>
+void GpuProfiler::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t frameSlots, bool pipelineStatistics) {
+	this->device = device;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	uint32_t validBits = queueFamilies[queueFamily].timestampValidBits;
+	if (validBits == 0) {
+		std::cout << "GPU profiler -> timestamps aren't supported on this queue, profiling disabled\n";
+		return;
+	}
+
+	timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+	timestampPeriod = properties.limits.timestampPeriod;
+	statisticsEnabled = pipelineStatistics;
+
+	slots.resize(frameSlots);
+	for (auto& slot : slots) {
+		VkQueryPoolCreateInfo timestampInfo{};
+		timestampInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		timestampInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		timestampInfo.queryCount = TIMESTAMP_COUNT;
+
+		if (vkCreateQueryPool(device, &timestampInfo, nullptr, &slot.timestampPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create timestamp query pool!");
+		}
+
+		if (statisticsEnabled) {
+			VkQueryPoolCreateInfo statisticsInfo{};
+			statisticsInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			statisticsInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			statisticsInfo.queryCount = 1;
+			statisticsInfo.pipelineStatistics = PIPELINE_STATISTICS;
+
+			if (vkCreateQueryPool(device, &statisticsInfo, nullptr, &slot.statisticsPool) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create pipeline statistics query pool!");
+			}
+		}
+	}
+
+	enabled = true;
+}
+
+void GpuProfiler::destroy() {
+	for (auto& slot : slots) {
+		vkDestroyQueryPool(device, slot.timestampPool, nullptr);
+		if (slot.statisticsPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, slot.statisticsPool, nullptr);
+		}
+	}
+
+	slots.clear();
+	enabled = false;
+}
+
+bool GpuProfiler::isEnabled() const {
+	return enabled;
+}
+
+bool GpuProfiler::hasPipelineStatistics() const {
+	return enabled && statisticsEnabled;
+}
+
+/// <summary>
+/// Resets the queries of the frame slot, must be recorded outside of a render pass
+/// </summary>
+void GpuProfiler::beginFrame(VkCommandBuffer comBuffer, uint32_t frameSlot, uint64_t frameNumber) {
+	if (!enabled) { return; }
+
+	currentSlot = frameSlot;
+	FrameSlot& slot = slots[currentSlot];
+	slot.frameNumber = frameNumber;
+	slot.pending = true;
+
+	vkCmdResetQueryPool(comBuffer, slot.timestampPool, 0, TIMESTAMP_COUNT);
+	if (statisticsEnabled) {
+		vkCmdResetQueryPool(comBuffer, slot.statisticsPool, 0, 1);
+	}
+}
+
+void GpuProfiler::beginRenderPass(VkCommandBuffer comBuffer) {
+	if (!enabled) { return; }
+	vkCmdWriteTimestamp(comBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slots[currentSlot].timestampPool, RENDER_PASS_BEGIN);
+}
+
+void GpuProfiler::beginDraw(VkCommandBuffer comBuffer) {
+	if (!enabled) { return; }
+
+	FrameSlot& slot = slots[currentSlot];
+	vkCmdWriteTimestamp(comBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.timestampPool, DRAW_BEGIN);
+	if (statisticsEnabled) {
+		vkCmdBeginQuery(comBuffer, slot.statisticsPool, 0, 0);
+	}
+}
+
+void GpuProfiler::endDraw(VkCommandBuffer comBuffer) {
+	if (!enabled) { return; }
+
+	FrameSlot& slot = slots[currentSlot];
+	if (statisticsEnabled) {
+		vkCmdEndQuery(comBuffer, slot.statisticsPool, 0);
+	}
+	vkCmdWriteTimestamp(comBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.timestampPool, DRAW_END);
+}
+
+void GpuProfiler::endRenderPass(VkCommandBuffer comBuffer) {
+	if (!enabled) { return; }
+	vkCmdWriteTimestamp(comBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slots[currentSlot].timestampPool, RENDER_PASS_END);
+}
+
+/// <summary>
+/// Reads back the results of the last frame recorded in this slot. Call it after the slot's fence has been waited on,
+/// the results are then available and reading them never stalls. Results that aren't ready yet are skipped
+/// </summary>
+void GpuProfiler::collect(uint32_t frameSlot) {
+	if (!enabled || !slots[frameSlot].pending) { return; }
+
+	FrameSlot& slot = slots[frameSlot];
+	uint64_t timestamps[TIMESTAMP_COUNT];
+	if (vkGetQueryPoolResults(device, slot.timestampPool, 0, TIMESTAMP_COUNT, sizeof(timestamps), timestamps,
+		sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+		return;
+	}
+
+	uint64_t statistics[3] = {};
+	if (statisticsEnabled && vkGetQueryPoolResults(device, slot.statisticsPool, 0, 1, sizeof(statistics), statistics,
+		sizeof(statistics), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+		return;
+	}
+
+	slot.pending = false;
+
+	auto toMs = [this](uint64_t begin, uint64_t end) {
+		return static_cast<double>((end - begin) & timestampMask) * timestampPeriod / 1e6;
+	};
+
+	GpuFrameTimings timings;
+	timings.frameNumber = slot.frameNumber;
+	timings.renderPassMs = toMs(timestamps[RENDER_PASS_BEGIN], timestamps[RENDER_PASS_END]);
+	timings.drawMs = toMs(timestamps[DRAW_BEGIN], timestamps[DRAW_END]);
+
+	// Statistics are written in the order of their flag bits
+	timings.vertexInvocations = statistics[0];
+	timings.clippingPrimitives = statistics[1];
+	timings.fragmentInvocations = statistics[2];
+
+	last = timings;
+	sum.renderPassMs += timings.renderPassMs;
+	sum.drawMs += timings.drawMs;
+	sum.vertexInvocations += timings.vertexInvocations;
+	sum.clippingPrimitives += timings.clippingPrimitives;
+	sum.fragmentInvocations += timings.fragmentInvocations;
+	collectedFrames++;
+
+	if (recordHistory) {
+		frames.push_back(timings);
+	}
+}
+
+/// <summary>
+/// Gets the most recently collected frame, a few frames behind the one being recorded
+/// </summary>
+std::optional<GpuFrameTimings> GpuProfiler::latest() const {
+	return last;
+}
+
+GpuFrameTimings GpuProfiler::average() const {
+	GpuFrameTimings avg;
+	if (collectedFrames == 0) { return avg; }
+
+	avg.frameNumber = collectedFrames;
+	avg.renderPassMs = sum.renderPassMs / collectedFrames;
+	avg.drawMs = sum.drawMs / collectedFrames;
+	avg.vertexInvocations = sum.vertexInvocations / collectedFrames;
+	avg.clippingPrimitives = sum.clippingPrimitives / collectedFrames;
+	avg.fragmentInvocations = sum.fragmentInvocations / collectedFrames;
+
+	return avg;
+}
+
+const std::vector<GpuFrameTimings>& GpuProfiler::history() const {
+	return frames;
+}
+
+/// <summary>
+/// Sets whether every collected frame is kept for history() and the file dumps, otherwise only the latest and the average are kept
+/// </summary>
+void GpuProfiler::keepHistory(bool keep) {
+	recordHistory = keep;
+}
+
+/// <summary>
+/// Clears the average and the history, e.g. between the steps of a benchmark sweep
+/// </summary>
+void GpuProfiler::resetStats() {
+	last.reset();
+	sum = GpuFrameTimings{};
+	collectedFrames = 0;
+	frames.clear();
+}
+
+void GpuProfiler::writeCsv(const std::string& path) const {
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		throw std::runtime_error("Could not open " + path + " for writing!");
+	}
+
+	file << "frame,render_pass_ms,draw_ms,vertex_invocations,clipping_primitives,fragment_invocations\n";
+	for (const auto& f : frames) {
+		file << f.frameNumber << ',' << f.renderPassMs << ',' << f.drawMs << ','
+			<< f.vertexInvocations << ',' << f.clippingPrimitives << ',' << f.fragmentInvocations << '\n';
+	}
+}
+
+void GpuProfiler::writeJson(const std::string& path) const {
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		throw std::runtime_error("Could not open " + path + " for writing!");
+	}
+
+	file << "[\n";
+	for (size_t i = 0; i < frames.size(); i++) {
+		const auto& f = frames[i];
+		file << "  {\"frame\": " << f.frameNumber
+			<< ", \"render_pass_ms\": " << f.renderPassMs
+			<< ", \"draw_ms\": " << f.drawMs
+			<< ", \"vertex_invocations\": " << f.vertexInvocations
+			<< ", \"clipping_primitives\": " << f.clippingPrimitives
+			<< ", \"fragment_invocations\": " << f.fragmentInvocations
+			<< (i + 1 < frames.size() ? "},\n" : "}\n");
+	}
+	file << "]\n";
+}
+
+/// <summary>
+/// Writes the history as JSON if the path ends in .json, otherwise as CSV
+/// </summary>
+void GpuProfiler::writeFile(const std::string& path) const {
+	if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0) {
+		writeJson(path);
+	}
+	else {
+		writeCsv(path);
+	}
+
+	std::cout << "GPU profiler -> wrote " << frames.size() << " frames to \"" << path << "\"\n";
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <vulkan/vulkan.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// GPU side timings and pipeline statistics of a single frame
+/// </summary>
+struct GpuFrameTimings {
+	uint64_t frameNumber = 0;
+	double renderPassMs = 0.0;
+	double drawMs = 0.0;
+
+	// Only filled when the device supports pipelineStatisticsQuery
+	uint64_t vertexInvocations = 0;
+	uint64_t clippingPrimitives = 0;
+	uint64_t fragmentInvocations = 0;
+};
+
+/// <summary>
+/// Records timestamps around the render pass and the draw, plus a pipeline statistics query, into one query pool per frame slot.
+/// Results are read back without waiting once the slot comes around again, i.e. frames-in-flight frames late
+/// </summary>
+class GpuProfiler {
+public:
+	// Statistics gathered by the pipeline statistics query, secondary command buffers executed inside it must inherit these
+	static constexpr VkQueryPipelineStatisticFlags PIPELINE_STATISTICS =
+		VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+	void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t frameSlots, bool pipelineStatistics);
+	void destroy();
+
+	bool isEnabled() const;
+	bool hasPipelineStatistics() const;
+
+	// Recording, call order per frame: beginFrame (outside a render pass), beginRenderPass, beginDraw, endDraw, endRenderPass
+	void beginFrame(VkCommandBuffer comBuffer, uint32_t frameSlot, uint64_t frameNumber);
+	void beginRenderPass(VkCommandBuffer comBuffer);
+	void beginDraw(VkCommandBuffer comBuffer);
+	void endDraw(VkCommandBuffer comBuffer);
+	void endRenderPass(VkCommandBuffer comBuffer);
+
+	void collect(uint32_t frameSlot);
+
+	std::optional<GpuFrameTimings> latest() const;
+	GpuFrameTimings average() const; // frameNumber holds the number of frames averaged
+	const std::vector<GpuFrameTimings>& history() const;
+	void keepHistory(bool keep);
+	void resetStats();
+
+	void writeCsv(const std::string& path) const;
+	void writeJson(const std::string& path) const;
+	void writeFile(const std::string& path) const;
+
+private:
+	enum Timestamp : uint32_t {
+		RENDER_PASS_BEGIN,
+		DRAW_BEGIN,
+		DRAW_END,
+		RENDER_PASS_END,
+		TIMESTAMP_COUNT
+	};
+
+	struct FrameSlot {
+		VkQueryPool timestampPool = VK_NULL_HANDLE;
+		VkQueryPool statisticsPool = VK_NULL_HANDLE;
+		uint64_t frameNumber = 0;
+		bool pending = false;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	std::vector<FrameSlot> slots;
+	uint32_t currentSlot = 0;
+
+	bool enabled = false;
+	bool statisticsEnabled = false;
+	double timestampPeriod = 1.0; // Nanoseconds per tick
+	uint64_t timestampMask = ~0ull;
+
+	std::optional<GpuFrameTimings> last;
+	GpuFrameTimings sum;
+	uint64_t collectedFrames = 0;
+
+	bool recordHistory = false;
+	std::vector<GpuFrameTimings> frames;
+};
+
+#endif // !GPUPROFILER_H
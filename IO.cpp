@@ -3,6 +3,18 @@
 
 #include <format>
 #include <iostream>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
 
 std::vector<char> IOHelper::readFile(const char* filename) {
 	std::ifstream file(filename, std::ios::ate | std::ios::binary);
@@ -23,4 +35,115 @@ std::vector<char> IOHelper::readFile(const char* filename) {
 #endif // !NDEBUG
 
 	return buffer;
+}
+
+void IOHelper::writeFile(const char* filename, const void* data, size_t size) {
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+
+	if (!file.is_open()) {
+		throw std::runtime_error(std::format("\nCould not open file {} for writing!", filename));
+	}
+
+	file.write(static_cast<const char*>(data), size);
+	file.close();
+
+#ifndef NDEBUG
+	std::cout << "IO -> wrote file \"" << filename << "\"!" << "\n";
+#endif // !NDEBUG
+}
+
+/// <summary>
+/// Maps a file read-only, without copying it
+/// </summary>
+MappedFile IOHelper::mapFile(const char* filename) {
+	MappedFile file(filename);
+
+#ifndef NDEBUG
+	std::cout << "IO -> mapped file \"" << filename << "\" (" << file.size() << " bytes)!" << "\n";
+#endif // !NDEBUG
+
+	return file;
+}
+
+MappedFile::MappedFile(const char* filename) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error(std::format("\nCould not open file {}!", filename));
+	}
+	fileHandle = file;
+
+	LARGE_INTEGER size{};
+	GetFileSizeEx(file, &size);
+	fileSize = static_cast<size_t>(size.QuadPart);
+	if (fileSize == 0) { return; }
+
+	mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr) {
+		unmap();
+		throw std::runtime_error(std::format("\nCould not map file {}!", filename));
+	}
+
+	view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error(std::format("\nCould not open file {}!", filename));
+	}
+
+	struct stat info {};
+	fstat(fd, &info);
+	fileSize = static_cast<size_t>(info.st_size);
+
+	if (fileSize > 0) {
+		void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+		view = mapping == MAP_FAILED ? nullptr : mapping;
+	}
+
+	// The mapping stays valid after the descriptor is closed
+	close(fd);
+#endif // _WIN32
+
+	if (fileSize > 0 && view == nullptr) {
+		unmap();
+		throw std::runtime_error(std::format("\nCould not map file {}!", filename));
+	}
+}
+
+MappedFile::~MappedFile() {
+	unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		unmap();
+
+		view = std::exchange(other.view, nullptr);
+		fileSize = std::exchange(other.fileSize, 0);
+#ifdef _WIN32
+		fileHandle = std::exchange(other.fileHandle, nullptr);
+		mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#endif // _WIN32
+	}
+
+	return *this;
+}
+
+void MappedFile::unmap() {
+#ifdef _WIN32
+	if (view != nullptr) { UnmapViewOfFile(view); }
+	if (mappingHandle != nullptr) { CloseHandle(mappingHandle); }
+	if (fileHandle != nullptr) { CloseHandle(fileHandle); }
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	if (view != nullptr) { munmap(const_cast<void*>(view), fileSize); }
+#endif // _WIN32
+
+	view = nullptr;
+	fileSize = 0;
 }
\ No newline at end of file
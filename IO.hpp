@@ -3,10 +3,47 @@
 
 #include <fstream>
 #include <vector>
+#include <span>
+
+/// <summary>
+/// A read-only memory mapping of a whole file, unmapped when it goes out of scope.
+/// The mapping starts on a page boundary, so the data is suitably aligned for any word size
+/// </summary>
+class MappedFile {
+public:
+	MappedFile() = default;
+	explicit MappedFile(const char* filename);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	const char* data() const { return static_cast<const char*>(view); }
+	size_t size() const { return fileSize; }
+	bool empty() const { return fileSize == 0; }
+
+	std::span<const char> bytes() const { return { data(), fileSize }; }
+
+	void unmap();
+
+private:
+	const void* view = nullptr;
+	size_t fileSize = 0;
+
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif // _WIN32
+};
 
 class IOHelper {
 public:
 	static std::vector<char> readFile(const char* filename);
+	static void writeFile(const char* filename, const void* data, size_t size);
+
+	static MappedFile mapFile(const char* filename);
 };
 
 #endif // !IO_H
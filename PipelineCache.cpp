@@ -0,0 +1,91 @@
+#include "PipelineCache.hpp"
+#include "IO.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+/// <summary>
+/// Creates the pipeline cache, seeded with the data at path if it exists and was written for this device
+/// </summary>
+/// <param name="path">Where the cache is read from and saved to</param>
+/// <param name="enabled">When false an empty cache is used and nothing is saved, used to measure cold starts</param>
+void PipelineCache::init(VkDevice device, VkPhysicalDevice physicalDevice, const std::string& path, bool enabled) {
+	this->device = device;
+	this->path = path;
+	this->enabled = enabled;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+	MappedFile file;
+	std::span<const char> data;
+	if (enabled && std::filesystem::exists(path)) {
+		file = IOHelper::mapFile(path.c_str());
+		data = file.bytes();
+
+		if (!isCompatible(data)) {
+			std::cout << "Pipeline cache -> \"" << path << "\" was written for another device or driver, starting empty\n";
+			data = {};
+		}
+	}
+
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = data.size();
+	createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(device, &createInfo, nullptr, &cache) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline cache!");
+	}
+
+	loaded = !data.empty();
+}
+
+/// <summary>
+/// Checks the VkPipelineCacheHeaderVersionOne at the start of the data against the selected physical device
+/// </summary>
+bool PipelineCache::isCompatible(std::span<const char> data) const {
+	VkPipelineCacheHeaderVersionOne header{};
+	if (data.size() < sizeof(header)) { return false; }
+
+	std::memcpy(&header, data.data(), sizeof(header));
+
+	return header.headerSize >= sizeof(header) &&
+		header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		header.vendorID == deviceProperties.vendorID &&
+		header.deviceID == deviceProperties.deviceID &&
+		std::memcmp(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+/// <summary>
+/// Writes the cache to disk
+/// </summary>
+void PipelineCache::save() {
+	if (!enabled || cache == VK_NULL_HANDLE) { return; }
+
+	size_t size = 0;
+	vkGetPipelineCacheData(device, cache, &size, nullptr);
+
+	std::vector<char> data(size);
+	if (size == 0 || vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) {
+		std::cerr << "Pipeline cache -> could not get the cache data, nothing saved\n";
+		return;
+	}
+
+	// Written next to the real file first, so a crash while saving can't leave a truncated cache behind
+	std::string tempPath = path + ".tmp";
+	IOHelper::writeFile(tempPath.c_str(), data.data(), size);
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::cerr << "Pipeline cache -> could not replace \"" << path << "\": " << error.message() << "\n";
+	}
+}
+
+void PipelineCache::destroy() {
+	if (cache != VK_NULL_HANDLE) {
+		vkDestroyPipelineCache(device, cache, nullptr);
+		cache = VK_NULL_HANDLE;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef PIPELINECACHE_H
+#define PIPELINECACHE_H
+
+#include <vulkan/vulkan.h>
+
+#include <span>
+#include <string>
+
+/// <summary>
+/// A VkPipelineCache that is loaded from disk at startup and written back at cleanup.
+/// Data from another driver or device is rejected by checking the cache header, the cache then starts out empty
+/// </summary>
+class PipelineCache {
+public:
+	void init(VkDevice device, VkPhysicalDevice physicalDevice, const std::string& path, bool enabled = true);
+	void save();
+	void destroy();
+
+	VkPipelineCache get() const { return cache; }
+	bool loadedFromDisk() const { return loaded; }
+	bool isEnabled() const { return enabled; }
+
+private:
+	bool isCompatible(std::span<const char> data) const;
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties deviceProperties{};
+	std::string path;
+
+	VkPipelineCache cache = VK_NULL_HANDLE;
+	bool loaded = false;
+	bool enabled = false;
+};
+
+#endif // !PIPELINECACHE_H
@@ -0,0 +1,100 @@
+#ifndef PIPELINEVARIANTS_H
+#define PIPELINEVARIANTS_H
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+/// <summary>
+/// Where the vertex shader takes the color from (COLOR_SOURCE)
+/// </summary>
+enum class ColorSource : uint32_t {
+	VertexTimesInstance = 0,
+	Vertex = 1,
+	Instance = 2
+};
+
+/// <summary>
+/// Values of the specialization constants in shader.vert and shader.frag, laid out as VkSpecializationInfo::pData
+/// </summary>
+struct SpecializationData {
+	ColorSource colorSource = ColorSource::VertexTimesInstance; // constant_id 0
+	VkBool32 instanced = VK_TRUE; // constant_id 1
+	VkBool32 alphaTest = VK_FALSE; // constant_id 2
+	float alphaCutoff = 0.5f; // constant_id 3
+};
+
+// Both stages get every entry, a stage ignores the constant ids it doesn't declare
+constexpr std::array<VkSpecializationMapEntry, 4> SPECIALIZATION_ENTRIES = { {
+	{ 0, offsetof(SpecializationData, colorSource), sizeof(ColorSource) },
+	{ 1, offsetof(SpecializationData, instanced), sizeof(VkBool32) },
+	{ 2, offsetof(SpecializationData, alphaTest), sizeof(VkBool32) },
+	{ 3, offsetof(SpecializationData, alphaCutoff), sizeof(float) },
+} };
+
+/// <summary>
+/// The graphics pipelines built at startup, one per variant, all in a single vkCreateGraphicsPipelines call
+/// </summary>
+enum class PipelineVariant : uint32_t {
+	Default,
+	VertexColor,
+	InstanceColor,
+	NonInstanced,
+	AlphaTested,
+	Count
+};
+
+struct PipelineVariantDesc {
+	PipelineVariant variant;
+	const char* name; // As given to --variant
+	SpecializationData data;
+};
+
+constexpr std::array<PipelineVariantDesc, static_cast<size_t>(PipelineVariant::Count)> PIPELINE_VARIANTS = { {
+	{ PipelineVariant::Default, "default", { ColorSource::VertexTimesInstance, VK_TRUE, VK_FALSE, 0.5f } },
+	{ PipelineVariant::VertexColor, "vertex-color", { ColorSource::Vertex, VK_TRUE, VK_FALSE, 0.5f } },
+	{ PipelineVariant::InstanceColor, "instance-color", { ColorSource::Instance, VK_TRUE, VK_FALSE, 0.5f } },
+	{ PipelineVariant::NonInstanced, "non-instanced", { ColorSource::Vertex, VK_FALSE, VK_FALSE, 0.5f } },
+	{ PipelineVariant::AlphaTested, "alpha-tested", { ColorSource::VertexTimesInstance, VK_TRUE, VK_TRUE, 0.5f } },
+} };
+
+constexpr bool variantsInOrder() {
+	for (size_t i = 0; i < PIPELINE_VARIANTS.size(); i++) {
+		if (static_cast<size_t>(PIPELINE_VARIANTS[i].variant) != i) { return false; }
+	}
+	return true;
+}
+static_assert(variantsInOrder(), "PIPELINE_VARIANTS must list the variants in the order of the PipelineVariant enum");
+
+constexpr const PipelineVariantDesc& getPipelineVariant(PipelineVariant variant) {
+	return PIPELINE_VARIANTS[static_cast<size_t>(variant)];
+}
+
+/// <summary>
+/// The specialization info of a variant, it points into the constant tables so it stays valid for the whole program
+/// </summary>
+inline VkSpecializationInfo getSpecializationInfo(PipelineVariant variant) {
+	VkSpecializationInfo info{};
+	info.mapEntryCount = static_cast<uint32_t>(SPECIALIZATION_ENTRIES.size());
+	info.pMapEntries = SPECIALIZATION_ENTRIES.data();
+	info.dataSize = sizeof(SpecializationData);
+	info.pData = &getPipelineVariant(variant).data;
+
+	return info;
+}
+
+/// <summary>
+/// Looks a variant up by its name, e.g. "alpha-tested"
+/// </summary>
+inline std::optional<PipelineVariant> findPipelineVariant(std::string_view name) {
+	for (const auto& desc : PIPELINE_VARIANTS) {
+		if (name == desc.name) { return desc.variant; }
+	}
+	return std::nullopt;
+}
+
+#endif // !PIPELINEVARIANTS_H
@@ -0,0 +1,352 @@
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace {
+	constexpr VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+	constexpr uint32_t NO_PASS = std::numeric_limits<uint32_t>::max();
+}
+
+void RenderGraph::reset() {
+	resources.clear();
+	passes.clear();
+	order.clear();
+	batches.clear();
+}
+
+RenderGraph::ResourceId RenderGraph::importBuffer(const char* name, VkBuffer buffer) {
+	Resource resource{};
+	resource.name = name;
+	resource.buffer = buffer;
+	resources.push_back(resource);
+
+	return static_cast<ResourceId>(resources.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::importImage(const char* name, VkImage image, const VkImageSubresourceRange& range, const ResourceUsage& initial) {
+	Resource resource{};
+	resource.name = name;
+	resource.image = image;
+	resource.range = range;
+	resource.initial = initial;
+	resources.push_back(resource);
+
+	return static_cast<ResourceId>(resources.size() - 1);
+}
+
+void RenderGraph::markOutput(ResourceId resource, const ResourceUsage& final) {
+	resources[resource].output = true;
+	resources[resource].final = final;
+}
+
+RenderGraph::PassId RenderGraph::addPass(const char* name, RecordFunction record) {
+	Pass pass{};
+	pass.name = name;
+	pass.record = std::move(record);
+	passes.push_back(std::move(pass));
+
+	return static_cast<PassId>(passes.size() - 1);
+}
+
+void RenderGraph::read(PassId pass, ResourceId resource, const ResourceUsage& usage) {
+	passes[pass].accesses.push_back({ resource, usage, false, false, usage.layout });
+}
+
+void RenderGraph::write(PassId pass, ResourceId resource, const ResourceUsage& usage) {
+	passes[pass].accesses.push_back({ resource, usage, true, false, usage.layout });
+}
+
+void RenderGraph::attachment(PassId pass, ResourceId image, const ResourceUsage& usage, VkImageLayout finalLayout) {
+	passes[pass].accesses.push_back({ image, usage, true, true, finalLayout });
+}
+
+/// <summary>
+/// Culls the passes nothing depends on, orders the rest and works out the barriers in front of each of them.
+/// The accesses are resolved in the order the passes were added, so a pass only ever depends on earlier ones
+/// </summary>
+void RenderGraph::compile() {
+	cullPasses();
+	orderPasses();
+
+	std::vector<ResourceState> states(resources.size());
+	for (size_t i = 0; i < resources.size(); i++) {
+		const ResourceUsage& initial = resources[i].initial;
+		VkAccessFlags initialWrites = initial.access & WRITE_ACCESS;
+		states[i] = { initial.layout, initialWrites != 0 ? initial.stages : 0, initialWrites, initial.stages, 0, 0, false };
+	}
+
+	batches.assign(order.size() + 1, {});
+
+	for (size_t i = 0; i < order.size(); i++) {
+		for (const Access& access : passes[order[i]].accesses) {
+			addBarrier(batches[i], resources[access.resource], states[access.resource], access.usage, access.write, access.renderPass);
+			if (access.renderPass) {
+				states[access.resource].layout = access.finalLayout;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < resources.size(); i++) {
+		if (resources[i].output) {
+			addBarrier(batches.back(), resources[i], states[i], resources[i].final, false, false);
+		}
+	}
+}
+
+/// <summary>
+/// Records every pass in order, each behind its batches of barriers
+/// </summary>
+void RenderGraph::execute(VkCommandBuffer comBuffer) const {
+	for (size_t i = 0; i < batches.size(); i++) {
+		for (const BarrierBatch& batch : batches[i]) {
+			bool memory = batch.memory.srcAccessMask != 0 || batch.memory.dstAccessMask != 0;
+			vkCmdPipelineBarrier(comBuffer, batch.srcStages, batch.dstStages, 0, memory ? 1 : 0, memory ? &batch.memory : nullptr,
+				0, nullptr, static_cast<uint32_t>(batch.images.size()), batch.images.data());
+		}
+
+		if (i < order.size()) {
+			passes[order[i]].record(comBuffer);
+		}
+	}
+}
+
+/// <summary>
+/// Prints the execution order with the barriers between the passes, and the culled passes
+/// </summary>
+void RenderGraph::print() const {
+	std::cout << "Render graph: " << order.size() << " of " << passes.size() << " passes, " << barrierCount() << " barriers\n";
+
+	for (size_t i = 0; i < batches.size(); i++) {
+		for (const BarrierBatch& batch : batches[i]) {
+			std::cout << std::hex << "  barrier 0x" << batch.srcStages << " -> 0x" << batch.dstStages << std::dec << ", "
+				<< batch.images.size() << " layout transition(s)\n";
+		}
+		if (i < order.size()) {
+			std::cout << "  " << passes[order[i]].name << "\n";
+		}
+	}
+
+	for (const Pass& pass : passes) {
+		if (pass.culled) {
+			std::cout << "  culled " << pass.name << "\n";
+		}
+	}
+}
+
+uint32_t RenderGraph::barrierCount() const {
+	size_t count = 0;
+	for (const auto& point : batches) {
+		count += point.size();
+	}
+
+	return static_cast<uint32_t>(count);
+}
+
+/// <summary>
+/// The same dependency compile() would put between before and the attachment, for the render pass to carry out instead
+/// </summary>
+VkSubpassDependency RenderGraph::externalDependency(const ResourceUsage& before, const ResourceUsage& attachment) {
+	VkSubpassDependency dependency{};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+	dependency.srcStageMask = before.stages != 0 ? before.stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	dependency.srcAccessMask = before.access & WRITE_ACCESS;
+	dependency.dstStageMask = attachment.stages;
+	dependency.dstAccessMask = attachment.access;
+
+	return dependency;
+}
+
+/// <summary>
+/// Walks back from the outputs. A pass is kept when it writes something still needed, then what it reads is needed
+/// from the passes before it, while what it overwrites without reading no longer is
+/// </summary>
+void RenderGraph::cullPasses() {
+	std::vector<bool> needed(resources.size());
+	for (size_t i = 0; i < resources.size(); i++) {
+		needed[i] = resources[i].output;
+	}
+
+	for (size_t p = passes.size(); p-- > 0;) {
+		Pass& pass = passes[p];
+		pass.culled = std::none_of(pass.accesses.begin(), pass.accesses.end(), [&](const Access& access) {
+			return access.write && needed[access.resource];
+		});
+		if (pass.culled) { continue; }
+
+		for (const Access& access : pass.accesses) {
+			if (access.write && (access.usage.access & ~WRITE_ACCESS) == 0) {
+				needed[access.resource] = false;
+			}
+		}
+		for (const Access& access : pass.accesses) {
+			if (!access.write || (access.usage.access & ~WRITE_ACCESS) != 0) {
+				needed[access.resource] = true;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Orders the kept passes topologically by their hazards (read after write, write after read and write after write).
+/// Among the passes that are ready, one that doesn't depend on the pass just scheduled goes first,
+/// so independent work sits between a producer and its consumer instead of the GPU draining at the barrier
+/// </summary>
+void RenderGraph::orderPasses() {
+	std::vector<std::vector<PassId>> dependents(passes.size());
+	std::vector<uint32_t> dependencyCounts(passes.size(), 0);
+
+	auto addEdge = [&](PassId from, PassId to) {
+		if (from == NO_PASS || from == to) { return; }
+		if (std::find(dependents[from].begin(), dependents[from].end(), to) != dependents[from].end()) { return; }
+
+		dependents[from].push_back(to);
+		dependencyCounts[to]++;
+	};
+
+	std::vector<PassId> lastWriters(resources.size(), NO_PASS);
+	std::vector<std::vector<PassId>> readers(resources.size()); // Since the last write
+	for (PassId p = 0; p < passes.size(); p++) {
+		if (passes[p].culled) { continue; }
+
+		for (const Access& access : passes[p].accesses) {
+			addEdge(lastWriters[access.resource], p);
+
+			if (access.write) {
+				for (PassId reader : readers[access.resource]) {
+					addEdge(reader, p);
+				}
+				readers[access.resource].clear();
+				lastWriters[access.resource] = p;
+			}
+			else {
+				readers[access.resource].push_back(p);
+			}
+		}
+	}
+
+	std::vector<PassId> ready;
+	for (PassId p = 0; p < passes.size(); p++) {
+		if (!passes[p].culled && dependencyCounts[p] == 0) {
+			ready.push_back(p);
+		}
+	}
+
+	order.clear();
+	PassId last = NO_PASS;
+	while (!ready.empty()) {
+		auto pick = ready.end();
+		for (auto it = ready.begin(); it != ready.end(); it++) {
+			bool dependsOnLast = last != NO_PASS && std::find(dependents[last].begin(), dependents[last].end(), *it) != dependents[last].end();
+			if (!dependsOnLast && (pick == ready.end() || *it < *pick)) {
+				pick = it;
+			}
+		}
+		if (pick == ready.end()) {
+			pick = std::min_element(ready.begin(), ready.end());
+		}
+
+		last = *pick;
+		ready.erase(pick);
+		order.push_back(last);
+
+		for (PassId dependent : dependents[last]) {
+			if (--dependencyCounts[dependent] == 0) {
+				ready.push_back(dependent);
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Adds what the access needs in front of its pass and moves the resource's state past it.
+/// Only writes are made available, reads after reads need nothing and a write after reads only waits for their stages.
+/// The barrier joins the batch with the same source stages, where buffers and images keeping their layout share the global memory barrier
+/// </summary>
+void RenderGraph::addBarrier(std::vector<BarrierBatch>& point, const Resource& resource, ResourceState& state, const ResourceUsage& usage, bool write, bool renderPass) {
+	bool layoutChange = resource.image != VK_NULL_HANDLE && !renderPass && usage.layout != state.layout;
+
+	// Until a pass has used the attachment, the render pass' external dependency covers it
+	bool coveredByRenderPass = renderPass && !state.touched;
+	state.touched = true;
+
+	VkPipelineStageFlags srcStages = 0;
+	VkAccessFlags srcAccess = 0;
+	if (write || layoutChange) {
+		srcStages = state.writeStages | state.readStages;
+		srcAccess = state.writeAccess;
+		if (layoutChange && srcStages == 0) {
+			srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		}
+	}
+	else if (usage.access != 0 && state.writeAccess != 0 &&
+		((usage.stages & ~state.visibleStages) != 0 || (usage.access & ~state.visibleAccess) != 0)) {
+		srcStages = state.writeStages;
+		srcAccess = state.writeAccess;
+	}
+
+	bool needed = srcStages != 0 && !coveredByRenderPass;
+	if (needed) {
+		auto found = std::find_if(point.begin(), point.end(), [&](const BarrierBatch& batch) { return batch.srcStages == srcStages; });
+		if (found == point.end()) {
+			BarrierBatch added{};
+			added.srcStages = srcStages;
+			added.memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			point.push_back(added);
+			found = point.end() - 1;
+		}
+
+		BarrierBatch& batch = *found;
+		batch.dstStages |= usage.stages != 0 ? usage.stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+		if (layoutChange) {
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstAccessMask = usage.access;
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = usage.layout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = resource.image;
+			barrier.subresourceRange = resource.range;
+			batch.images.push_back(barrier);
+		}
+		else {
+			batch.memory.srcAccessMask |= srcAccess;
+			batch.memory.dstAccessMask |= usage.access;
+		}
+	}
+
+	if (write) {
+		// Not even the same stage sees the writes without another barrier
+		state.writeStages = usage.stages;
+		state.writeAccess = usage.access & WRITE_ACCESS;
+		state.readStages = 0;
+		state.visibleStages = 0;
+		state.visibleAccess = 0;
+	}
+	else if (layoutChange) {
+		// The transition is the write, and the barrier already made it visible to this read
+		state.writeStages = usage.stages;
+		state.writeAccess = 0;
+		state.readStages = usage.stages;
+		state.visibleStages = usage.stages;
+		state.visibleAccess = usage.access;
+	}
+	else {
+		state.readStages |= usage.stages;
+		if (needed) {
+			state.visibleStages |= usage.stages;
+			state.visibleAccess |= usage.access;
+		}
+	}
+
+	if (layoutChange) {
+		state.layout = usage.layout;
+	}
+}
@@ -0,0 +1,110 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// <summary>
+/// How something uses a resource: the stages touching it, with which accesses and, for images, in which layout
+/// </summary>
+struct ResourceUsage {
+	VkPipelineStageFlags stages = 0;
+	VkAccessFlags access = 0;
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED; // Ignored for buffers
+};
+
+/// <summary>
+/// A frame's GPU work as passes declaring the resources they read and write. compile() orders the passes,
+/// culls the ones nothing depends on and works out the barriers from the declared usages. At every transition point,
+/// the gap before a pass and the end of the graph, the dependencies waiting on the same source stages share one
+/// vkCmdPipelineBarrier, with the buffer hazards merged into a single global memory barrier and an image barrier only
+/// where a layout changes. Dependencies on different source stages stay apart, so neither widens the other's destination stages.
+/// Rebuilt every frame, the resources are imported since their handles change from frame to frame
+/// </summary>
+class RenderGraph {
+public:
+	using ResourceId = uint32_t;
+	using PassId = uint32_t;
+	using RecordFunction = std::function<void(VkCommandBuffer)>;
+
+	void reset();
+
+	ResourceId importBuffer(const char* name, VkBuffer buffer);
+	// initial is how the image was used before the graph, e.g. its layout and the stage the acquire semaphore is waited on
+	ResourceId importImage(const char* name, VkImage image, const VkImageSubresourceRange& range, const ResourceUsage& initial);
+	// The resource is used like this after the graph, the passes leading up to it are never culled
+	void markOutput(ResourceId resource, const ResourceUsage& final);
+
+	PassId addPass(const char* name, RecordFunction record);
+	void read(PassId pass, ResourceId resource, const ResourceUsage& usage);
+	void write(PassId pass, ResourceId resource, const ResourceUsage& usage);
+	// A render pass attachment, the render pass moves it from its current layout to finalLayout by itself
+	void attachment(PassId pass, ResourceId image, const ResourceUsage& usage, VkImageLayout finalLayout);
+
+	void compile();
+	void execute(VkCommandBuffer comBuffer) const;
+	void print() const;
+
+	uint32_t barrierCount() const; // vkCmdPipelineBarrier calls execute records
+
+	// The external dependency of a render pass whose attachment was last used like before
+	static VkSubpassDependency externalDependency(const ResourceUsage& before, const ResourceUsage& attachment);
+
+private:
+	struct Access {
+		ResourceId resource;
+		ResourceUsage usage;
+		bool write;
+		bool renderPass; // The layouts are changed by the render pass
+		VkImageLayout finalLayout;
+	};
+
+	struct Pass {
+		const char* name;
+		RecordFunction record;
+		std::vector<Access> accesses;
+		bool culled = false;
+	};
+
+	struct Resource {
+		const char* name;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkImage image = VK_NULL_HANDLE;
+		VkImageSubresourceRange range{};
+		ResourceUsage initial;
+		bool output = false;
+		ResourceUsage final;
+	};
+
+	// Where the resource stands while the barriers are worked out
+	struct ResourceState {
+		VkImageLayout layout;
+		VkPipelineStageFlags writeStages; // The last write, or the layout transition
+		VkAccessFlags writeAccess;
+		VkPipelineStageFlags readStages; // Every read since then, later writes must wait for them
+		VkPipelineStageFlags visibleStages; // The stages and accesses the last write has been made visible to
+		VkAccessFlags visibleAccess;
+		bool touched; // Used by a pass, until then a render pass' external dependency covers it
+	};
+
+	struct BarrierBatch {
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+		VkMemoryBarrier memory{};
+		std::vector<VkImageMemoryBarrier> images;
+	};
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<PassId> order; // The passes that weren't culled, in execution order
+	std::vector<std::vector<BarrierBatch>> batches; // batches[i] go before order[i], the last ones after every pass. One per source stage mask
+
+	void cullPasses();
+	void orderPasses();
+	void addBarrier(std::vector<BarrierBatch>& point, const Resource& resource, ResourceState& state, const ResourceUsage& usage, bool write, bool renderPass);
+};
+
+#endif // !RENDERGRAPH_H
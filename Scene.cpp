@@ -0,0 +1,172 @@
+#include "Scene.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SCENE_SSE
+#include <immintrin.h>
+#endif
+
+namespace {
+	/// <summary>
+	/// out = a * b for column major matrices. Every column of out is the columns of a weighted by one column of b,
+	/// so with SSE (part of every x86-64 CPU) a column costs four broadcasts, four multiplies and three adds
+	/// </summary>
+	void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+#ifdef SCENE_SSE
+		const float* left = &a[0].x;
+		const float* right = &b[0].x;
+		__m128 column0 = _mm_loadu_ps(left);
+		__m128 column1 = _mm_loadu_ps(left + 4);
+		__m128 column2 = _mm_loadu_ps(left + 8);
+		__m128 column3 = _mm_loadu_ps(left + 12);
+
+		float* result = &out[0].x;
+		for (int column = 0; column < 4; column++) {
+			const float* weights = right + 4 * column;
+			__m128 sum = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(weights[0])), _mm_mul_ps(column1, _mm_set1_ps(weights[1]))),
+				_mm_add_ps(_mm_mul_ps(column2, _mm_set1_ps(weights[2])), _mm_mul_ps(column3, _mm_set1_ps(weights[3]))));
+			_mm_storeu_ps(result + 4 * column, sum);
+		}
+#else
+		out = a * b;
+#endif
+	}
+}
+
+void Scene::clear() {
+	version = 0;
+	parents.clear();
+	translationX.clear();
+	translationY.clear();
+	translationZ.clear();
+	rotation.clear();
+	scaleX.clear();
+	scaleY.clear();
+	scaleZ.clear();
+	dirty.clear();
+	locals.clear();
+	world.clear();
+	worldVersions.clear();
+}
+
+void Scene::reserve(uint32_t count) {
+	parents.reserve(count);
+	translationX.reserve(count);
+	translationY.reserve(count);
+	translationZ.reserve(count);
+	rotation.reserve(count);
+	scaleX.reserve(count);
+	scaleY.reserve(count);
+	scaleZ.reserve(count);
+	dirty.reserve(count);
+	locals.reserve(count);
+	world.reserve(count);
+	worldVersions.reserve(count);
+}
+
+/// <returns>The node's index, which is also its instance index</returns>
+uint32_t Scene::addNode(uint32_t parent, glm::vec3 translation, float nodeRotation, glm::vec3 scale) {
+	if (parent != NO_PARENT && parent >= count()) {
+		throw std::runtime_error("A scene node's parent must be added before it!");
+	}
+
+	uint32_t node = count();
+	parents.push_back(parent);
+	translationX.push_back(translation.x);
+	translationY.push_back(translation.y);
+	translationZ.push_back(translation.z);
+	rotation.push_back(nodeRotation);
+	scaleX.push_back(scale.x);
+	scaleY.push_back(scale.y);
+	scaleZ.push_back(scale.z);
+	dirty.push_back(1);
+	locals.push_back(glm::mat4(1.0f));
+	world.push_back(glm::mat4(1.0f));
+	worldVersions.push_back(0);
+
+	return node;
+}
+
+void Scene::setTranslation(uint32_t node, glm::vec3 translation) {
+	translationX[node] = translation.x;
+	translationY[node] = translation.y;
+	translationZ[node] = translation.z;
+	dirty[node] = 1;
+}
+
+void Scene::setRotation(uint32_t node, float nodeRotation) {
+	rotation[node] = nodeRotation;
+	dirty[node] = 1;
+}
+
+void Scene::setScale(uint32_t node, glm::vec3 scale) {
+	scaleX[node] = scale.x;
+	scaleY[node] = scale.y;
+	scaleZ[node] = scale.z;
+	dirty[node] = 1;
+}
+
+/// <summary>
+/// One pass over the nodes in order. A parent always comes first, so by the time a node is reached its parent's
+/// world matrix is final and stamped with this update's version if it changed
+/// </summary>
+uint32_t Scene::update() {
+	version++;
+	uint32_t recomputed = 0;
+
+	for (uint32_t node = 0; node < count(); node++) {
+		uint32_t parent = parents[node];
+		bool parentChanged = parent != NO_PARENT && worldVersions[parent] == version;
+		if (!dirty[node] && !parentChanged) { continue; }
+
+		if (dirty[node]) {
+			locals[node] = localMatrix(node);
+			dirty[node] = 0;
+		}
+
+		if (parent == NO_PARENT) {
+			world[node] = locals[node];
+		}
+		else {
+			multiply(world[parent], locals[node], world[node]);
+		}
+
+		worldVersions[node] = version;
+		recomputed++;
+	}
+
+	return recomputed;
+}
+
+/// <summary>
+/// The instance offset is the world translation and its scale the length of the world x and y axes.
+/// The instances have no rotation, so a rotated node is drawn axis aligned, only its position follows the rotation
+/// </summary>
+void Scene::writeInstances(InstanceData* instances, uint64_t sinceVersion) const {
+	for (uint32_t node = 0; node < count(); node++) {
+		if (worldVersions[node] <= sinceVersion) { continue; }
+
+		const glm::mat4& m = world[node];
+		instances[node].offset = glm::vec2(m[3].x, m[3].y);
+		instances[node].scale = glm::vec2(std::sqrt(m[0].x * m[0].x + m[0].y * m[0].y), std::sqrt(m[1].x * m[1].x + m[1].y * m[1].y));
+	}
+}
+
+/// <summary>
+/// Translation * rotation around z * scale, built directly instead of multiplying the three
+/// </summary>
+glm::mat4 Scene::localMatrix(uint32_t node) const {
+	float cosine = std::cos(rotation[node]);
+	float sine = std::sin(rotation[node]);
+
+	glm::mat4 local(1.0f);
+	local[0] = glm::vec4(cosine * scaleX[node], sine * scaleX[node], 0.0f, 0.0f);
+	local[1] = glm::vec4(-sine * scaleY[node], cosine * scaleY[node], 0.0f, 0.0f);
+	local[2] = glm::vec4(0.0f, 0.0f, scaleZ[node], 0.0f);
+	local[3] = glm::vec4(translationX[node], translationY[node], translationZ[node], 1.0f);
+
+	return local;
+}
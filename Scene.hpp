@@ -0,0 +1,61 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+
+#include "Vertex.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/// <summary>
+/// A transform hierarchy kept as structure-of-arrays. A node can only be added after its parent, so the arrays are
+/// always sorted parents first and one front to back pass recomputes every world matrix. Only the nodes marked dirty
+/// and their descendants are recomputed, each with a single SIMD mat4 multiply.
+/// Node i is drawn as instance i, its world transform is written straight into mapped instance buffers
+/// </summary>
+class Scene {
+public:
+	static constexpr uint32_t NO_PARENT = std::numeric_limits<uint32_t>::max();
+
+	void clear();
+	void reserve(uint32_t count);
+	// The rotation is around z, the quads lie in the xy plane
+	uint32_t addNode(uint32_t parent, glm::vec3 translation, float rotation, glm::vec3 scale);
+
+	void setTranslation(uint32_t node, glm::vec3 translation);
+	void setRotation(uint32_t node, float rotation);
+	void setScale(uint32_t node, glm::vec3 scale);
+
+	// Recomputes the dirty nodes and their descendants, returns how many were recomputed
+	uint32_t update();
+
+	// Writes the offset and scale of every node recomputed by an update after sinceVersion, the rest is left as it is
+	void writeInstances(InstanceData* instances, uint64_t sinceVersion) const;
+
+	uint32_t count() const { return static_cast<uint32_t>(parents.size()); }
+	uint64_t getVersion() const { return version; } // Counts the updates
+	const glm::mat4& getWorld(uint32_t node) const { return world[node]; }
+
+private:
+	uint64_t version = 0;
+
+	std::vector<uint32_t> parents;
+	std::vector<float> translationX;
+	std::vector<float> translationY;
+	std::vector<float> translationZ;
+	std::vector<float> rotation;
+	std::vector<float> scaleX;
+	std::vector<float> scaleY;
+	std::vector<float> scaleZ;
+	std::vector<uint8_t> dirty; // The local transform changed since the last update
+
+	std::vector<glm::mat4> locals; // Rebuilt from the components when dirty, so moving a parent only costs its descendants a multiply
+	std::vector<glm::mat4> world;
+	std::vector<uint64_t> worldVersions; // The update that last recomputed the node's world matrix
+
+	glm::mat4 localMatrix(uint32_t node) const;
+};
+
+#endif // !SCENE_H
@@ -0,0 +1,64 @@
+#include "ShaderRegistry.hpp"
+
+#include <format>
+#include <stdexcept>
+#include <string>
+
+// The .inc files are comma separated SPIR-V words written by glslc -mfmt=num in the pre-build step
+namespace {
+	alignas(4) constexpr uint32_t shaderVert[] = {
+#include "shaders/generated/shader.vert.inc"
+	};
+
+	alignas(4) constexpr uint32_t shaderFrag[] = {
+#include "shaders/generated/shader.frag.inc"
+	};
+
+	alignas(4) constexpr uint32_t texturedFrag[] = {
+#include "shaders/generated/textured.frag.inc"
+	};
+
+	alignas(4) constexpr uint32_t instancesComp[] = {
+#include "shaders/generated/instances.comp.inc"
+	};
+
+	alignas(4) constexpr uint32_t cullComp[] = {
+#include "shaders/generated/cull.comp.inc"
+	};
+
+	struct EmbeddedShader {
+		std::string_view name;
+		std::span<const uint32_t> code;
+	};
+
+	constexpr EmbeddedShader embeddedShaders[] = {
+		{ "shader.vert", shaderVert },
+		{ "shader.frag", shaderFrag },
+		{ "textured.frag", texturedFrag },
+		{ "instances.comp", instancesComp },
+		{ "cull.comp", cullComp },
+	};
+
+	constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+	constexpr bool allValid() {
+		for (const auto& shader : embeddedShaders) {
+			if (shader.code.empty() || shader.code[0] != SPIRV_MAGIC) { return false; }
+		}
+		return true;
+	}
+	static_assert(allValid(), "An embedded shader is not valid SPIR-V, rerun scripts/compile_shaders");
+}
+
+/// <summary>
+/// Gets the SPIR-V of an embedded shader by its source file name, e.g. "shader.vert"
+/// </summary>
+std::span<const uint32_t> ShaderRegistry::get(std::string_view name) {
+	for (const auto& shader : embeddedShaders) {
+		if (shader.name == name) {
+			return shader.code;
+		}
+	}
+
+	throw std::runtime_error(std::format("\nNo embedded shader called {}!", std::string(name)));
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef SHADERREGISTRY_H
+#define SHADERREGISTRY_H
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+/// <summary>
+/// Hands out the SPIR-V that was compiled and embedded into the binary at build time (see scripts/compile_shaders),
+/// so creating shader modules needs no file I/O
+/// </summary>
+class ShaderRegistry {
+public:
+	static std::span<const uint32_t> get(std::string_view name);
+};
+
+#endif // !SHADERREGISTRY_H
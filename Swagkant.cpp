@@ -4,13 +4,41 @@
 /// Inits the window & vulkan, starts the main loop and finishes by cleaning up everything
 /// </summary>
 /// <param name="title">The window title</param>
-void SwagkantApp::run(const char* title) {
+/// <param name="appSettings">Runtime options such as the number of frames in flight</param>
+void SwagkantApp::run(const char* title, const AppSettings& appSettings) {
 	//_putenv_s("VK_LOADER_LAYERS_DISABLE", "ALL");
 	//_putenv_s("VK_INSTANCE_LAYERS", ":VK_LAYER_KHRONOS_validation:");
 
-	initWindow(title);
+	startTime = std::chrono::steady_clock::now();
+
+	settings = appSettings;
+	settings.framesInFlight = std::clamp(settings.framesInFlight, MIN_FRAMES_IN_FLIGHT, MAX_FRAMES_IN_FLIGHT);
+	windowTitle = title;
+
+	if (settings.benchCulling) {
+		benchmarkCulling();
+		return;
+	}
+
+	if (!settings.headless) {
+		initWindow(title);
+	}
 	initVulkan();
-	mainLoop();
+	if (settings.benchAllocator) {
+		benchmarkAllocator();
+	}
+	else if (settings.benchInstances) {
+		benchmarkInstances();
+	}
+	else if (settings.benchRecord) {
+		benchmarkRecording();
+	}
+	else if (settings.benchResize) {
+		benchmarkResize();
+	}
+	else {
+		mainLoop();
+	}
 	cleanup();
 }
 
@@ -21,13 +49,25 @@ void SwagkantApp::initWindow(const char* title) {
 	glfwInit();
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
 	window = glfwCreateWindow(WIDTH, HEIGHT, title, nullptr, nullptr);
+	glfwSetWindowUserPointer(window, this);
+	glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+}
+
+/// <summary>
+/// Flags the swap chain for recreation, the driver doesn't always report VK_ERROR_OUT_OF_DATE_KHR after a resize
+/// </summary>
+void SwagkantApp::framebufferResizeCallback(GLFWwindow* window, int width, int height) {
+	auto app = reinterpret_cast<SwagkantApp*>(glfwGetWindowUserPointer(window));
+	app->framebufferResized = true;
 }
 
 /// <summary>
 /// Sets up vulkan by creating instanreces, seting up the debug messenger...
+/// Everything after the logical device runs as a task graph, the pipelines are built on worker threads
+/// while the swap chain, buffers and command pools are created on the main thread
 /// </summary>
 void SwagkantApp::initVulkan() {
 #ifndef NDEBUG
@@ -36,7 +76,9 @@ void SwagkantApp::initVulkan() {
 	createInstance();
 
 	setupDebugMessenger(&debugMessenger, enableValidationLayers, instance);
-	createSurface();
+	if (!settings.headless) {
+		createSurface();
+	}
 
 #ifndef NDEBUG
 	printDebugSection("PHYSICAL DEVICE(s)");
@@ -44,71 +86,651 @@ void SwagkantApp::initVulkan() {
 	pickPhysicalDevice();
 
 	createLogicalDevice();
-	createSwapchain();
-	createImageViews();
-	createRenderPass();
-	createGraphicsPipeline();
-	createFramebuffers();
-	createCommandPool();
-	createCommandBuffer();
-	createSyncObjects();
+	allocator.init(device, physicalDevice);
+
+	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+	uploader.init(device, &allocator, indices.transferFamily.value(), transferQueue, indices.graphicsFamily.value());
+#ifndef NDEBUG
+	std::cout << "Uploads run on " << (uploader.isDedicated() ? "a dedicated transfer queue" : "the graphics queue") << "\n";
+#endif // !NDEBUG
+	pipelineCache.init(device, physicalDevice, settings.pipelineCachePath, settings.usePipelineCache);
+
+	deviceSetupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+	// The compute shader already animates the instances
+	sceneEnabled = settings.scene && !settings.computeInstances;
+	if (settings.scene && !sceneEnabled) {
+		std::cerr << "The scene can't be combined with the compute animation, drawing the compute animated instances\n";
+	}
+
+	// The CPU only knows where the static grid's instances are, and the GPU culling already decides what gets drawn
+	cpuCullingEnabled = settings.cpuCulling && !settings.computeInstances && !sceneEnabled && !gpuCullingEnabled;
+	if (settings.cpuCulling && !cpuCullingEnabled) {
+		std::cerr << "CPU culling needs the static grid without GPU culling, drawing every instance\n";
+	}
+#ifndef NDEBUG
+	if (cpuCullingEnabled) {
+		std::cout << "CPU culling with the " << FrustumCuller::kernelName(frustumCuller.getKernel()) << " kernel\n";
+	}
+#endif // !NDEBUG
+
+	// GLFW, the allocator and the uploader are only used from the main thread. The pipelines only need the device,
+	// the render pass (or just the format with dynamic rendering) and the pipeline cache, which is internally synchronized
+	using TaskId = TaskGraph::TaskId;
+
+	TaskId swapchainTask = initTasks.add("swap chain", [this] {
+		if (settings.headless) {
+			createOffscreenImages();
+		}
+		else {
+			createSwapchain();
+		}
+	});
+	TaskId imageViewsTask = initTasks.add("image views", [this] { createImageViews(); }, { swapchainTask });
+	TaskId renderPassTask = initTasks.add("render pass", [this] { createRenderPass(); }, { swapchainTask });
+	TaskId uniformRingTask = initTasks.add("uniform ring", [this] {
+		uniformRing.init(device, physicalDevice, &allocator, settings.framesInFlight);
+	});
+
+	// The pipeline layout needs the set layouts and the instances the texture count, the uploads stay on the main thread
+	std::vector<TaskId> pipelineDependencies = { renderPassTask, uniformRingTask };
+	std::vector<TaskId> instanceBufferDependencies;
+	if (texturesEnabled) {
+		TaskId texturesTask = initTasks.add("textures", [this] {
+			textureManager.init(device, physicalDevice, &allocator, &uploader, settings.framesInFlight);
+			textureStreamer.init(device, physicalDevice, &allocator, &textureManager, &deletionQueue,
+				TextureStreamer::DEFAULT_RING_SIZE, settings.streamBudgetKb * 1024ull);
+			createTextures();
+		});
+		pipelineDependencies.push_back(texturesTask);
+		instanceBufferDependencies.push_back(texturesTask);
+	}
+	initTasks.add("graphics pipeline", [this] { createGraphicsPipeline(); }, pipelineDependencies, false);
+	initTasks.add("framebuffers", [this] { createFramebuffers(); }, { imageViewsTask, renderPassTask });
+
+	if (settings.computeInstances) {
+		// The animated instance buffers are written to the compute pipeline's descriptor sets
+		instanceBufferDependencies.push_back(initTasks.add("compute pipeline", [this] { createComputePipeline(); }, {}, false));
+	}
+	if (gpuCullingEnabled) {
+		// Likewise the culling buffers, and the culling pipeline reads the frame uniforms
+		instanceBufferDependencies.push_back(initTasks.add("cull pipeline", [this] { createCullPipeline(); }, { uniformRingTask }, false));
+	}
+
+	TaskId commandPoolTask = initTasks.add("command pool", [this] { createCommandPool(); });
+	initTasks.add("vertex & index buffers", [this] {
+		createVertexBuffer();
+		createIndexBuffer();
+	});
+	initTasks.add("instance buffer", [this] { createInstanceBuffer(settings.instanceCount); }, instanceBufferDependencies);
+	initTasks.add("command buffers", [this] {
+		createCommandBuffers();
+		if (settings.computeInstances) {
+			createComputeCommandBuffers();
+		}
+		setRecordThreads(settings.recordThreads);
+	}, { commandPoolTask });
+	initTasks.add("sync objects", [this] { createSyncObjects(); }, { swapchainTask });
+	initTasks.add("gpu profiler", [this] {
+		gpuProfiler.init(device, physicalDevice, findQueueFamilies(physicalDevice).graphicsFamily.value(), settings.framesInFlight, pipelineStatisticsEnabled);
+		gpuProfiler.keepHistory(!settings.gpuStatsPath.empty());
+	});
+
+	// At most two tasks are ever off the main thread
+	ThreadPool initPool;
+	initPool.init(std::min(2u, ThreadPool::hardwareThreads() - 1));
+	initTasks.run(initPool);
 }
 
 /// <summary>
-/// The programs main loop containing a while loop in which it polls events
+/// The programs main loop containing a while loop in which it polls events.
+/// Frame times are collected in frameStats and the fps is shown in the window title once a second.
+/// In headless mode it renders a fixed number of frames instead
 /// </summary>
 void SwagkantApp::mainLoop() {
-	while (!glfwWindowShouldClose(window)) {
+	using clock = std::chrono::steady_clock;
+
+	frameStats.reset();
+	auto lastFrame = clock::now();
+	auto lastTitleUpdate = lastFrame;
+	uint32_t titleFrames = 0;
+
+	while (settings.headless ? frameStats.frameCount() < settings.headlessFrames : !glfwWindowShouldClose(window)) {
+		if (!settings.headless) {
+			glfwPollEvents();
+		}
+		drawFrame();
+
+		auto now = clock::now();
+		if (frameNumber == 1) {
+			const char* cacheState = !pipelineCache.isEnabled() ? "disabled" : pipelineCache.loadedFromDisk() ? "loaded from disk" : "cold";
+			std::cout << "Time to first frame: " << std::chrono::duration<double, std::milli>(now - startTime).count() << " ms"
+				<< " (pipeline creation " << pipelineCreationMs << " ms, pipeline cache " << cacheState << ")\n";
+			std::cout << "  Instance & device " << deviceSetupMs << " ms, init tasks " << initTasks.totalMs() << " ms:\n";
+			initTasks.printTimings();
+		}
+
+		frameStats.addFrame(std::chrono::duration<double>(now - lastFrame).count());
+		lastFrame = now;
+		titleFrames++;
+
+		double sinceTitleUpdate = std::chrono::duration<double>(now - lastTitleUpdate).count();
+		if (!settings.headless && sinceTitleUpdate >= 1.0) {
+			std::string title = windowTitle + " - " + std::to_string(static_cast<uint32_t>(titleFrames / sinceTitleUpdate)) +
+				" fps (" + std::to_string(settings.framesInFlight) + " in flight)";
+			glfwSetWindowTitle(window, title.c_str());
+
+			lastTitleUpdate = now;
+			titleFrames = 0;
+		}
+
+		if (settings.benchmarkSeconds > 0.0 && frameStats.totalSeconds() >= settings.benchmarkSeconds) {
+			break;
+		}
+	}
+
+	vkDeviceWaitIdle(device);
+
+	std::string label = std::to_string(settings.framesInFlight) + " frame(s) in flight" + (settings.headless ? ", headless" : "");
+	frameStats.print(label.c_str());
+
+	if (sceneEnabled) {
+		std::cout << "Scene: " << scene.count() << " nodes, " << sceneRecomputedNodes << " recomputed per frame | update avg "
+			<< sceneStats.averageMs() << " ms | p99 " << sceneStats.percentileMs(99.0) << " ms | max " << sceneStats.maxMs() << " ms\n";
+	}
+
+	// Everything has finished now, so the last frames can be collected as well
+	for (uint32_t i = 0; i < settings.framesInFlight; i++) {
+		gpuProfiler.collect((currentFrame + i) % settings.framesInFlight);
+	}
+
+	if (gpuProfiler.isEnabled()) {
+		GpuFrameTimings avg = gpuProfiler.average();
+		std::cout << "GPU: render pass " << avg.renderPassMs << " ms | draw " << avg.drawMs << " ms";
+		if (gpuProfiler.hasPipelineStatistics()) {
+			std::cout << " | " << avg.vertexInvocations << " vertex, " << avg.clippingPrimitives << " clipped primitives, "
+				<< avg.fragmentInvocations << " fragment invocations";
+		}
+		std::cout << " (average per frame)\n";
+	}
+
+	if (!settings.gpuStatsPath.empty()) {
+		gpuProfiler.writeFile(settings.gpuStatsPath);
+	}
+}
+
+/// <summary>
+/// Microbenchmark of the GPU memory allocator, compares allocate/free throughput against plain vkAllocateMemory
+/// and measures fragmentation after a long random churn of live allocations
+/// </summary>
+void SwagkantApp::benchmarkAllocator() {
+	using clock = std::chrono::steady_clock;
+	const uint32_t allocationCount = 10000;
+	const uint32_t liveCount = 2000;
+	const uint32_t churnSteps = 100000;
+
+	// Every allocation of the throughput test is live at once, rounded up to the next power of two by the buddy allocator.
+	// Up to 1 MiB that is over 3 GB, so the largest size shrinks until the expected total fits a quarter of the device local heap
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	uint32_t memoryType = allocator.findMemoryType(~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	VkDeviceSize budget = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size / 4;
+
+	auto expectedBytes = [&](uint32_t maxShift) {
+		VkDeviceSize roundedSum = 0;
+		for (uint32_t shift = 8; shift <= maxShift; shift++) {
+			roundedSum += 2ull << shift;
+		}
+		return roundedSum / (maxShift - 7) * allocationCount;
+	};
+
+	uint32_t maxShift = 20;
+	while (maxShift > 8 && expectedBytes(maxShift) > budget) {
+		maxShift--;
+	}
+	std::cout << "Allocator: sizes from 256 B to " << (1ull << maxShift) / 1024.0 << " KiB, about "
+		<< expectedBytes(maxShift) / (1024 * 1024) << " MiB live of a " << budget / (1024 * 1024) << " MiB budget\n";
+
+	std::mt19937 rng(1337);
+	std::uniform_int_distribution<uint32_t> sizeShift(8, maxShift); // Spread evenly over the powers of two
+
+	auto randomRequirements = [&]() {
+		VkMemoryRequirements requirements{};
+		requirements.size = (1ull << sizeShift(rng)) + rng() % 256;
+		requirements.alignment = 256;
+		requirements.memoryTypeBits = ~0u;
+		return requirements;
+	};
+
+	auto msSince = [](clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	};
+
+	GpuAllocator benchAllocator;
+	benchAllocator.init(device, physicalDevice);
+
+	// Allocate/free throughput
+	std::vector<GpuAllocation> allocations(allocationCount);
+	auto start = clock::now();
+	for (auto& allocation : allocations) {
+		allocation = benchAllocator.allocate(randomRequirements(), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+	double allocateMs = msSince(start);
+	benchAllocator.printStats("Allocator after allocating");
+
+	std::shuffle(allocations.begin(), allocations.end(), rng);
+	start = clock::now();
+	for (auto& allocation : allocations) {
+		benchAllocator.free(allocation);
+	}
+	double freeMs = msSince(start);
+
+	std::cout << "Allocator: " << allocationCount << " allocations, " << allocateMs * 1000.0 / allocationCount << " us per allocate, "
+		<< freeMs * 1000.0 / allocationCount << " us per free\n";
+
+	// The same against the driver, kept well below maxMemoryAllocationCount
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	uint32_t driverCount = std::min(1000u, properties.limits.maxMemoryAllocationCount / 4);
+
+	std::vector<VkDeviceMemory> driverAllocations(driverCount);
+	start = clock::now();
+	for (auto& memory : driverAllocations) {
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = randomRequirements().size;
+		allocInfo.memoryTypeIndex = allocator.findMemoryType(~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate device memory!");
+		}
+	}
+	allocateMs = msSince(start);
+
+	start = clock::now();
+	for (auto memory : driverAllocations) {
+		vkFreeMemory(device, memory, nullptr);
+	}
+	freeMs = msSince(start);
+
+	std::cout << "vkAllocateMemory: " << driverCount << " allocations, " << allocateMs * 1000.0 / driverCount << " us per allocate, "
+		<< freeMs * 1000.0 / driverCount << " us per free\n";
+
+	// Churn, replace a random live allocation each step
+	allocations.resize(liveCount);
+	for (auto& allocation : allocations) {
+		allocation = benchAllocator.allocate(randomRequirements(), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+
+	start = clock::now();
+	for (uint32_t i = 0; i < churnSteps; i++) {
+		GpuAllocation& allocation = allocations[rng() % liveCount];
+		benchAllocator.free(allocation);
+		allocation = benchAllocator.allocate(randomRequirements(), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+	double churnMs = msSince(start);
+
+	std::cout << "Allocator churn: " << churnSteps << " free + allocate steps with " << liveCount << " live, "
+		<< churnMs * 1000.0 / churnSteps << " us per step\n";
+	benchAllocator.printStats("Allocator after churn");
+
+	for (auto& allocation : allocations) {
+		benchAllocator.free(allocation);
+	}
+	benchAllocator.destroy();
+}
+
+/// <summary>
+/// Sweeps the instance count from 1 to MAX_INSTANCES in steps of 10x and renders INSTANCE_BENCH_FRAMES frames per step,
+/// printing the CPU record time, the frame time and the GPU draw time of each step
+/// </summary>
+void SwagkantApp::benchmarkInstances() {
+	using clock = std::chrono::steady_clock;
+
+	std::cout << "instances | record ms | frame ms | fps | gpu draw ms\n";
+
+	for (uint32_t count = 1; count <= MAX_INSTANCES; count *= 10) {
+		// The previous instance buffer may still be in use and its queries still pending
+		vkDeviceWaitIdle(device);
+		for (uint32_t slot = 0; slot < settings.framesInFlight; slot++) {
+			gpuProfiler.collect(slot);
+		}
+
+		createInstanceBuffer(count);
+		frameStats.reset();
+		recordStats.reset();
+		gpuProfiler.resetStats();
+
+		auto lastFrame = clock::now();
+		for (uint32_t i = 0; i < INSTANCE_BENCH_FRAMES; i++) {
+			if (!settings.headless) {
+				glfwPollEvents();
+				if (glfwWindowShouldClose(window)) { break; }
+			}
+			drawFrame();
+
+			auto now = clock::now();
+			frameStats.addFrame(std::chrono::duration<double>(now - lastFrame).count());
+			lastFrame = now;
+		}
+
+		std::cout << count << " | " << recordStats.averageMs() << " | " << frameStats.averageMs() << " | " << frameStats.averageFps()
+			<< " | " << (gpuProfiler.isEnabled() ? gpuProfiler.average().drawMs : 0.0) << "\n";
+	}
+
+	vkDeviceWaitIdle(device);
+}
+
+/// <summary>
+/// Renders INSTANCE_BENCH_FRAMES frames with 0 (inline), 1, 2, 4... up to the hardware thread count of recording threads
+/// and prints the CPU record time of each, so the scaling over cores can be compared
+/// </summary>
+void SwagkantApp::benchmarkRecording() {
+	using clock = std::chrono::steady_clock;
+
+	if (settings.drawCount <= 1) {
+		settings.drawCount = RECORD_BENCH_DRAWS;
+	}
+	if (drawInstanceCount < settings.drawCount) {
+		vkDeviceWaitIdle(device);
+		createInstanceBuffer(settings.drawCount);
+	}
+
+	std::vector<uint32_t> threadCounts = { 0 };
+	uint32_t hardwareThreads = ThreadPool::hardwareThreads();
+	for (uint32_t threads = 1; threads < hardwareThreads; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(hardwareThreads);
+
+	std::cout << activeDrawCount() << " draws, " << drawInstanceCount << " instances\n";
+	std::cout << "threads | record ms | speedup | frame ms\n";
+
+	double singleThreadMs = 0.0;
+	for (uint32_t threads : threadCounts) {
+		vkDeviceWaitIdle(device);
+		setRecordThreads(threads);
+		frameStats.reset();
+		recordStats.reset();
+
+		auto lastFrame = clock::now();
+		for (uint32_t i = 0; i < INSTANCE_BENCH_FRAMES; i++) {
+			if (!settings.headless) {
+				glfwPollEvents();
+				if (glfwWindowShouldClose(window)) { break; }
+			}
+			drawFrame();
+
+			auto now = clock::now();
+			frameStats.addFrame(std::chrono::duration<double>(now - lastFrame).count());
+			lastFrame = now;
+		}
+
+		if (threads == 1) {
+			singleThreadMs = recordStats.averageMs();
+		}
+
+		std::cout << (threads == 0 ? std::string("inline") : std::to_string(threads)) << " | " << recordStats.averageMs() << " | ";
+		if (threads > 0 && singleThreadMs > 0.0) {
+			std::cout << singleThreadMs / recordStats.averageMs() << "x";
+		}
+		else {
+			std::cout << "-";
+		}
+		std::cout << " | " << frameStats.averageMs() << "\n";
+	}
+
+	vkDeviceWaitIdle(device);
+}
+
+/// <summary>
+/// Resize stress test, renders RESIZE_BENCH_FRAMES frames while switching the window between two sizes every RESIZE_BENCH_INTERVAL frames.
+/// Frames that recreated the swap chain are reported apart from the rest, so spikes show up in their p99 and max
+/// </summary>
+void SwagkantApp::benchmarkResize() {
+	using clock = std::chrono::steady_clock;
+
+	if (settings.headless) {
+		throw std::runtime_error("The resize stress test needs a window!");
+	}
+
+	FrameStats steadyStats;
+	FrameStats resizeStats;
+	recreateStats.reset();
+
+	bool previousRecreated = false;
+	auto lastFrame = clock::now();
+	for (uint32_t i = 0; i < RESIZE_BENCH_FRAMES && !glfwWindowShouldClose(window); i++) {
+		if (i % RESIZE_BENCH_INTERVAL == 0) {
+			bool large = (i / RESIZE_BENCH_INTERVAL) % 2 == 0;
+			glfwSetWindowSize(window, large ? WIDTH + WIDTH / 2 : WIDTH, large ? HEIGHT + HEIGHT / 2 : HEIGHT);
+		}
+
 		glfwPollEvents();
+		swapchainRecreated = false;
 		drawFrame();
+
+		auto now = clock::now();
+		double frameSeconds = std::chrono::duration<double>(now - lastFrame).count();
+		lastFrame = now;
+
+		// The first frame into the new images counts as a resize frame too
+		if (swapchainRecreated || previousRecreated) {
+			resizeStats.addFrame(frameSeconds);
+		}
+		else {
+			steadyStats.addFrame(frameSeconds);
+		}
+		previousRecreated = swapchainRecreated;
 	}
 
 	vkDeviceWaitIdle(device);
+
+	steadyStats.print("Steady frames");
+	resizeStats.print("Resize frames");
+	std::cout << "Swap chain recreated " << recreateStats.frameCount() << " times, " << recreateStats.averageMs() << " ms avg, "
+		<< recreateStats.maxMs() << " ms max (CPU)\n";
+}
+
+/// <summary>
+/// Microbenchmark of the CPU frustum culling, tests CULL_BENCH_OBJECTS random spheres against a perspective frustum
+/// with every kernel the CPU supports and prints the throughput of each. Needs neither a window nor a device
+/// </summary>
+void SwagkantApp::benchmarkCulling() {
+	using clock = std::chrono::steady_clock;
+
+	std::mt19937 rng(1337);
+	std::uniform_real_distribution<float> side(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> depth(-200.0f, 0.0f);
+	std::uniform_real_distribution<float> radius(0.1f, 2.0f);
+
+	FrustumCuller culler;
+	culler.reserve(CULL_BENCH_OBJECTS);
+	for (uint32_t i = 0; i < CULL_BENCH_OBJECTS; i++) {
+		culler.add({ side(rng), side(rng), depth(rng) }, radius(rng));
+	}
+
+	// Looking down -z from the origin, so a part of the volume is in view
+	glm::mat4 viewProjection = glm::perspectiveRH_ZO(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+
+	std::cout << "Culling " << CULL_BENCH_OBJECTS << " spheres, " << CULL_BENCH_PASSES << " passes per kernel\n";
+	std::cout << "kernel | visible | ms per pass | Mobjects/s | speedup\n";
+
+	double scalarMs = 0.0;
+	size_t scalarVisible = 0;
+	for (CullKernel kernel : { CullKernel::Scalar, CullKernel::Sse, CullKernel::Avx2 }) {
+		if (!FrustumCuller::isSupported(kernel)) {
+			std::cout << FrustumCuller::kernelName(kernel) << " | not supported by this CPU\n";
+			continue;
+		}
+		culler.setKernel(kernel);
+
+		size_t visible = culler.cull(viewProjection).size(); // Warms the caches
+		auto start = clock::now();
+		for (uint32_t pass = 0; pass < CULL_BENCH_PASSES; pass++) {
+			visible = culler.cull(viewProjection).size();
+		}
+		double passMs = std::chrono::duration<double, std::milli>(clock::now() - start).count() / CULL_BENCH_PASSES;
+
+		if (kernel == CullKernel::Scalar) {
+			scalarMs = passMs;
+			scalarVisible = visible;
+		}
+
+		std::cout << FrustumCuller::kernelName(kernel) << " | " << visible << " | " << passMs << " | " << CULL_BENCH_OBJECTS / (passMs * 1000.0)
+			<< " | " << scalarMs / passMs << "x\n";
+		if (visible != scalarVisible) {
+			std::cerr << FrustumCuller::kernelName(kernel) << " disagrees with the scalar kernel!\n";
+		}
+	}
 }
 
+/// <summary>
+/// Renders a frame using the current frame slot. The CPU only waits for the slot it is about to reuse,
+/// so it can record frame N+1 while the GPU is still busy with frame N.
+/// In headless mode each slot owns an offscreen image, so there is nothing to acquire or present
+/// </summary>
 void SwagkantApp::drawFrame() {
-	vkWaitForFences(device, 1, &flightFence, VK_TRUE, UINT64_MAX);
-	vkResetFences(device, 1, &flightFence);
+	VkCommandBuffer commandBuffer = commandBuffers[currentFrame];
+
+	uint64_t completedFrames = waitForFrameSlot();
+	deletionQueue.flush(completedFrames);
+
+	// The slot's previous frame is done, so its queries can be read without stalling
+	gpuProfiler.collect(currentFrame);
+
+	// Free the finished uploads and start the copies queued since the last frame, they run while this one is recorded
+	uploader.collect(completedFrames);
+	uploader.flush();
+
+	// Levels whose copies have completed become visible from this frame on
+	if (texturesEnabled) {
+		textureStreamer.collect(frameNumber, completedFrames);
+		textureManager.beginFrame(currentFrame);
+	}
+
+	uint32_t imageIndex = currentFrame;
+	if (!settings.headless) {
+		int width = 0, height = 0;
+		glfwGetFramebufferSize(window, &width, &height);
+		if (width == 0 || height == 0) {
+			// Minimized, there is nothing to render to until the window comes back
+			glfwWaitEvents();
+			return;
+		}
+
+		VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageReadySemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			// Nothing was acquired and the fence is still signaled, so the frame can simply be skipped
+			recreateSwapchain();
+			return;
+		}
+		else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+			throw std::runtime_error("Kunne ikke hente et swap chain image!");
+		}
+	}
+
+	// Only reset once it is certain that work gets submitted with it
+	VkFence flightFence = VK_NULL_HANDLE;
+	if (!timelineEnabled) {
+		flightFence = flightFences[currentFrame];
+		vkResetFences(device, 1, &flightFence);
+	}
 
-	uint32_t imageIndex;
-	vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageReadySemaphore, VK_NULL_HANDLE, &imageIndex);
+	frameWaitSemaphores.clear();
+	frameWaitStages.clear();
+	if (!settings.headless) {
+		frameWaitSemaphores.push_back(imageReadySemaphores[currentFrame]);
+		frameWaitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	}
+
+	// Submitted before recording, so on an async compute queue the simulation runs alongside the previous frame's rendering
+	if (settings.computeInstances) {
+		submitCompute(frameWaitSemaphores, frameWaitStages);
+	}
+	if (sceneEnabled) {
+		updateScene();
+	}
 
 	vkResetCommandBuffer(commandBuffer, 0);
+	auto recordStart = std::chrono::steady_clock::now();
 	recordCommandBuffer(commandBuffer, imageIndex);
+	recordStats.addFrame(std::chrono::duration<double>(std::chrono::steady_clock::now() - recordStart).count());
 
 	VkSubmitInfo submitInfo{};
-	VkSemaphore waitSems[] = { imageReadySemaphore };
-	VkSemaphore singalSems[] = { renderDoneSemaphore };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.pWaitDstStageMask = waitStages;
-	
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSems;
+	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(frameWaitSemaphores.size());
+	submitInfo.pWaitSemaphores = frameWaitSemaphores.data();
+	submitInfo.pWaitDstStageMask = frameWaitStages.data();
 
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = singalSems;
+	if (!settings.headless) {
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &renderDoneSemaphores[imageIndex];
+	}
 
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
+	// The timeline is signaled along with the binary render-done semaphore, whose value is ignored
+	std::vector<VkSemaphore> signalSemaphores;
+	std::vector<uint64_t> waitValues;
+	std::vector<uint64_t> signalValues;
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	if (timelineEnabled) {
+		waitValues.resize(frameWaitSemaphores.size(), 0);
+		for (size_t i = 0; i < frameWaitSemaphores.size(); i++) {
+			if (frameWaitSemaphores[i] == computeTimeline) {
+				waitValues[i] = frameNumber + 1;
+			}
+		}
+
+		signalSemaphores.assign(submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+		signalSemaphores.push_back(graphicsTimeline);
+		signalValues.resize(signalSemaphores.size(), 0);
+		signalValues.back() = frameNumber + 1;
+
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+		timelineInfo.pWaitSemaphoreValues = waitValues.data();
+		timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+		timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		submitInfo.pSignalSemaphores = signalSemaphores.data();
+	}
+
 	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, flightFence) != VK_SUCCESS) {
 		throw std::runtime_error("Kan desvrre ej tilbyde en fin draw command buffer... undskyld :(");
 	}
 
-	VkSwapchainKHR swapChains[] = { swapChain };
-	VkPresentInfoKHR presentInfo{};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = singalSems;
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = swapChains;
-	presentInfo.pImageIndices = &imageIndex;
-	presentInfo.pResults = nullptr;
+	bool recreate = false;
+	if (!settings.headless) {
+		VkSwapchainKHR swapChains[] = { swapChain };
+		VkPresentInfoKHR presentInfo{};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = &renderDoneSemaphores[imageIndex];
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = swapChains;
+		presentInfo.pImageIndices = &imageIndex;
+		presentInfo.pResults = nullptr;
+
+		VkResult result = vkQueuePresentKHR(presentQueue, &presentInfo);
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
+			recreate = true;
+		}
+		else if (result != VK_SUCCESS) {
+			throw std::runtime_error("Kunne ikke prsentere swap chain image!");
+		}
+	}
+
+	currentFrame = (currentFrame + 1) % settings.framesInFlight;
+	frameNumber++;
 
-	if (vkQueuePresentKHR(presentQueue, &presentInfo) != VK_SUCCESS) {
-		throw std::runtime_error("");
+	// After the frame counter moved on, so the retired resources wait for this frame as well
+	if (recreate) {
+		recreateSwapchain();
 	}
 }
 
@@ -120,13 +742,34 @@ void SwagkantApp::cleanup() {
 	printDebugSection("CLEANUP", false); // Layer loading happens around here... I guess
 #endif // !NDEBUG
 
+	destroyInstanceBuffer(); // Queues the instance buffers for deletion
+	deletionQueue.flushAll();
+	uploader.destroy();
+	destroyCulling();
+	textureStreamer.destroy();
+	textureManager.destroy();
+	uniformRing.destroy();
+	destroyCompute();
+	gpuProfiler.destroy();
+	recordPool.destroy();
+	destroySecondaryCommandBuffers();
 	vkDestroyCommandPool(device, commandPool, nullptr);
 
+	vkDestroyBuffer(device, indexBuffer, nullptr);
+	allocator.free(indexBufferMemory);
+	vkDestroyBuffer(device, vertexBuffer, nullptr);
+	allocator.free(vertexBufferMemory);
+
+	pipelineCache.save();
+	pipelineCache.destroy();
+
 	for (auto fb : swapChainFramebuffers) {
 		vkDestroyFramebuffer(device, fb, nullptr);
 	}
 
-	vkDestroyPipeline(device, graphicsPipeline, nullptr);
+	for (auto pipeline : graphicsPipelines) {
+		vkDestroyPipeline(device, pipeline, nullptr);
+	}
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyRenderPass(device, renderPass, nullptr);
 
@@ -134,22 +777,49 @@ void SwagkantApp::cleanup() {
 		vkDestroyImageView(device, imageView, nullptr);
 	}
 
-	vkDestroySemaphore(device, imageReadySemaphore, nullptr);
-	vkDestroySemaphore(device, renderDoneSemaphore, nullptr);
-	vkDestroyFence(device, flightFence, nullptr);
+	for (auto semaphore : imageReadySemaphores) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+
+	for (auto semaphore : renderDoneSemaphores) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+
+	for (auto fence : flightFences) {
+		vkDestroyFence(device, fence, nullptr);
+	}
+
+	if (graphicsTimeline != VK_NULL_HANDLE) {
+		vkDestroySemaphore(device, graphicsTimeline, nullptr);
+	}
+	if (computeTimeline != VK_NULL_HANDLE) {
+		vkDestroySemaphore(device, computeTimeline, nullptr);
+	}
+
+	for (size_t i = 0; i < offscreenImages.size(); i++) {
+		vkDestroyImage(device, offscreenImages[i], nullptr);
+		allocator.free(offscreenImageMemory[i]);
+	}
+	allocator.destroy();
 
-	vkDestroySwapchainKHR(device, swapChain, nullptr);
+	if (swapChain != VK_NULL_HANDLE) {
+		vkDestroySwapchainKHR(device, swapChain, nullptr);
+	}
 	vkDestroyDevice(device, nullptr);
 
 	if (enableValidationLayers) {
 		destroyDebugMessenger(instance, debugMessenger, nullptr);
 	}
 
-	vkDestroySurfaceKHR(instance, surface, nullptr);
+	if (surface != VK_NULL_HANDLE) {
+		vkDestroySurfaceKHR(instance, surface, nullptr);
+	}
 	vkDestroyInstance(instance, nullptr);
 
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	if (window != nullptr) {
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
 }
 
 /// <summary>
@@ -167,7 +837,23 @@ void SwagkantApp::createInstance() {
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "Keine motor";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+
+	// 1.1 gives the device UUIDs to the device selection. Timeline semaphores are core in 1.2, and so is everything
+	// VK_KHR_dynamic_rendering depends on. A 1.0 loader doesn't have vkEnumerateInstanceVersion and fails on any newer version
+	auto enumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+	uint32_t loaderVersion = VK_API_VERSION_1_0;
+	if (enumerateInstanceVersion != nullptr) {
+		enumerateInstanceVersion(&loaderVersion);
+	}
+
+	instanceApiVersion = VK_API_VERSION_1_0;
+	if (loaderVersion >= VK_API_VERSION_1_2 && (settings.timelineSemaphores || settings.dynamicRendering || settings.bindlessTextures)) {
+		instanceApiVersion = VK_API_VERSION_1_2;
+	}
+	else if (loaderVersion >= VK_API_VERSION_1_1) {
+		instanceApiVersion = VK_API_VERSION_1_1;
+	}
+	appInfo.apiVersion = instanceApiVersion;
 
 	/* Creates the createInfo variable which will hold the appInfo created above,
 	* how many, along with which extensions and layers are enabled
@@ -211,8 +897,12 @@ void SwagkantApp::createInstance() {
 /// <returns>A cstring vector of the required extensions</returns>
 std::vector<const char*> SwagkantApp::getRequiredExtensions() {
 	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	const char** glfwExtensions = nullptr;
+
+	// Headless mode has no window, so none of the surface extensions GLFW asks for are needed
+	if (!settings.headless) {
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	}
 
 	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
 	if (enableValidationLayers) { extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME); }
@@ -256,73 +946,38 @@ bool SwagkantApp::checkValidationLayerSupport() {
 	return true;
 }
 
+/// <summary>
+/// Picks the GPU with the DeviceSelector, which prints why each device was chosen or rejected
+/// </summary>
 void SwagkantApp::pickPhysicalDevice() {
-	uint32_t deviceCount = 0;
-	vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
-
-	if (deviceCount == 0) {
-		throw std::runtime_error("Failed to find GPUs with Vulkan support!");
-	}
-
-	std::vector<VkPhysicalDevice> devices(deviceCount);
-	std::multimap<int, VkPhysicalDevice> candidates; // automatically sorts based on score
-	vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
-
-	for (const auto& device : devices) {
-		int score = ratePhysicalDevice(device);
-		candidates.insert(std::make_pair(score, device));
-	}
-
-	// Check if the best candidate is suitable at all
-	if (candidates.rbegin()->first > 0) {
-		VkPhysicalDevice _device = candidates.rbegin()->second;
-		physicalDevice = isDeviceSuitable(_device) ? _device : VK_NULL_HANDLE;
-	}
-	else {
-		throw std::runtime_error("Failed to find a suitable GPU!");
-	}
-
-	if (physicalDevice == VK_NULL_HANDLE) {
-		throw std::runtime_error("Failed to find a suitable GPU!");
-	}
+	DeviceSelector selector;
+	physicalDevice = selector.select(instance, instanceApiVersion,
+		[this](VkPhysicalDevice device) { return checkDeviceRequirements(device); },
+		optionalDeviceExtensions, settings.deviceUuid, settings.probeDevices);
 }
 
-uint32_t SwagkantApp::ratePhysicalDevice(VkPhysicalDevice device) {
-	VkPhysicalDeviceProperties deviceProperties;
-	VkPhysicalDeviceFeatures deviceFeatures;
-
-	vkGetPhysicalDeviceProperties(device, &deviceProperties);
-	vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
-
-	int score = 0;
-	if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
-		score += 1000; // Discrete GPUs have a significant performance advantage
+/// <summary>
+/// Checks what the app can't run without: graphics (and present) queues, the required extensions and a usable swap chain
+/// </summary>
+/// <returns>Why the device is unsuitable, empty when it is suitable</returns>
+std::string SwagkantApp::checkDeviceRequirements(VkPhysicalDevice device) {
+	QueueFamilyIndices indices = findQueueFamilies(device);
+	if (!indices.graphicsFamily.has_value()) {
+		return "no graphics queue";
 	}
-
-	// Maximum possible size of textures affects graphics quality
-	score += deviceProperties.limits.maxImageDimension2D;
-	if (!deviceFeatures.geometryShader) {
-		return 0; // Application can't function without geometry shaders
+	if (!settings.headless && !indices.presentFamily.has_value()) {
+		return "can't present to the window surface";
 	}
 
-#ifndef NDEBUG
-	std::cout << "Physical device: " << deviceProperties.deviceName << " >> " << score << '\n';
-#endif
-
-	return score;
-}
-
-bool SwagkantApp::isDeviceSuitable(VkPhysicalDevice device) {
-	QueueFamilyIndices indices = findQueueFamilies(device);
-	bool extensionsSupported = checkDeviceExtensionSupport(device);
-	bool swapChainAdequate = false;
+	if (!checkDeviceExtensionSupport(device)) {
+		return "missing required extensions";
+	}
 
-	if (extensionsSupported) {
-		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
-		swapChainAdequate = swapChainSupport.isComplete();
+	if (!settings.headless && !querySwapChainSupport(device).isComplete()) {
+		return "no surface formats or present modes";
 	}
 
-	return indices.isComplete() && extensionsSupported && swapChainAdequate;
+	return "";
 }
 
 QueueFamilyIndices SwagkantApp::findQueueFamilies(VkPhysicalDevice device) {
@@ -334,32 +989,67 @@ QueueFamilyIndices SwagkantApp::findQueueFamilies(VkPhysicalDevice device) {
 	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
+	// A transfer-only family is usually backed by DMA engines that run alongside the graphics queue,
+	// a compute family without graphics is the next best thing
+	std::optional<uint32_t> transferOnlyFamily;
+	std::optional<uint32_t> nonGraphicsFamily;
+	std::optional<uint32_t> asyncComputeFamily;
+
 	int i = 0;
 	for (const auto& queueFamily : queueFamilies) {
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-			indices.graphicsFamily = i;
+		if (!indices.isComplete(settings.headless)) {
+			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+				indices.graphicsFamily = i;
+			}
+
+			if (!settings.headless) {
+				VkBool32 presentSupport = false;
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+
+				if (presentSupport) { indices.presentFamily = i; }
+			}
 		}
 
-		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		if ((queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !asyncComputeFamily.has_value()) {
+			asyncComputeFamily = i;
+		}
 
-		if (presentSupport) { indices.presentFamily = i; }
-		if (indices.isComplete()) { break; }
+		if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+			if (!(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !transferOnlyFamily.has_value()) {
+				transferOnlyFamily = i;
+			}
+			else if (!nonGraphicsFamily.has_value()) {
+				nonGraphicsFamily = i;
+			}
+		}
 
 		i++;
 	}
 
-	return indices;
-}
-
-bool SwagkantApp::checkDeviceExtensionSupport(VkPhysicalDevice device) {
+	if (transferOnlyFamily.has_value()) {
+		indices.transferFamily = transferOnlyFamily;
+	}
+	else if (nonGraphicsFamily.has_value()) {
+		indices.transferFamily = nonGraphicsFamily;
+	}
+	else {
+		indices.transferFamily = indices.graphicsFamily;
+	}
+
+	indices.computeFamily = asyncComputeFamily.has_value() ? asyncComputeFamily : indices.graphicsFamily;
+
+	return indices;
+}
+
+bool SwagkantApp::checkDeviceExtensionSupport(VkPhysicalDevice device) {
 	uint32_t extensionCount;
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
 	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-	std::set<std::string> requiredExtenstions(deviceExtensions.begin(), deviceExtensions.end());
+	const auto& extensions = getDeviceExtensions();
+	std::set<std::string> requiredExtenstions(extensions.begin(), extensions.end());
 	for (const auto& extension : availableExtensions) {
 		auto found = requiredExtenstions.erase(extension.extensionName);
 #ifndef NDEBUG
@@ -370,6 +1060,29 @@ bool SwagkantApp::checkDeviceExtensionSupport(VkPhysicalDevice device) {
 	return requiredExtenstions.empty();
 }
 
+/// <summary>
+/// Whether the device supports an optional extension, the required ones are checked by checkDeviceExtensionSupport
+/// </summary>
+bool SwagkantApp::hasDeviceExtension(VkPhysicalDevice device, const char* name) {
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto& extension : availableExtensions) {
+		if (strcmp(extension.extensionName, name) == 0) { return true; }
+	}
+	return false;
+}
+
+/// <summary>
+/// Gets the device extensions needed in the current mode, headless mode doesn't need the swap chain
+/// </summary>
+const std::vector<const char*>& SwagkantApp::getDeviceExtensions() const {
+	return settings.headless ? headlessDeviceExtensions : deviceExtensions;
+}
+
 SwapChainSupportDetails SwagkantApp::querySwapChainSupport(VkPhysicalDevice device) {
 	SwapChainSupportDetails details;
 	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
@@ -441,11 +1154,14 @@ VkExtent2D SwagkantApp::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabil
 	}
 }
 
-VkShaderModule SwagkantApp::createShaderModule(const std::vector<char>& code) {
+/// <summary>
+/// Creates a shader module from SPIR-V words, the code only has to stay alive until this returns
+/// </summary>
+VkShaderModule SwagkantApp::createShaderModule(std::span<const uint32_t> code) {
 	VkShaderModuleCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+	createInfo.codeSize = code.size_bytes();
+	createInfo.pCode = code.data();
 
 	VkShaderModule shaderModule;
 	if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
@@ -462,10 +1178,16 @@ void SwagkantApp::createLogicalDevice() {
 	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = {
-		indices.graphicsFamily.value(),
-		indices.presentFamily.value()
-	};
+	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value() };
+	if (indices.presentFamily.has_value()) {
+		uniqueQueueFamilies.insert(indices.presentFamily.value());
+	}
+	if (indices.transferFamily.has_value()) {
+		uniqueQueueFamilies.insert(indices.transferFamily.value());
+	}
+	if (indices.computeFamily.has_value()) {
+		uniqueQueueFamilies.insert(indices.computeFamily.value());
+	}
 
 	float queuePriority = 1.0f;
 	for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -477,15 +1199,126 @@ void SwagkantApp::createLogicalDevice() {
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+	// Pipeline statistics are only used by the GPU profiler, so they're enabled when available.
+	// Secondary command buffers can only run inside the statistics query with inheritedQueries
 	VkPhysicalDeviceFeatures deviceFeatures{};
+	deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+	deviceFeatures.inheritedQueries = supportedFeatures.inheritedQueries;
+
+	// The culling pass issues all its draws with one indirect call
+	gpuCullingEnabled = settings.gpuCulling && supportedFeatures.multiDrawIndirect == VK_TRUE;
+	deviceFeatures.multiDrawIndirect = gpuCullingEnabled ? VK_TRUE : VK_FALSE;
+	if (settings.gpuCulling && !gpuCullingEnabled) {
+		std::cerr << "Multi draw indirect is not supported, culling nothing and drawing from the CPU\n";
+	}
+
+	bool usesSecondaries = settings.recordThreads > 0 || settings.benchRecord;
+	pipelineStatisticsEnabled = supportedFeatures.pipelineStatisticsQuery == VK_TRUE &&
+		(!usesSecondaries || supportedFeatures.inheritedQueries == VK_TRUE);
+
+	// The timeline path needs both the instance and the device at 1.2, otherwise the fences are used
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+	timelineEnabled = false;
+	if (settings.timelineSemaphores && instanceApiVersion >= VK_API_VERSION_1_2 && deviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &timelineFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+		timelineEnabled = timelineFeatures.timelineSemaphore == VK_TRUE;
+		timelineFeatures.pNext = nullptr;
+	}
+	if (settings.timelineSemaphores && !timelineEnabled) {
+		std::cerr << "Timeline semaphores are not supported, using fences\n";
+	}
+
+	std::vector<const char*> extensions = getDeviceExtensions();
+
+	// Dynamic rendering is used when the extension is there, otherwise the render pass path is kept
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+	dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+	dynamicRenderingEnabled = false;
+	if (settings.dynamicRendering && instanceApiVersion >= VK_API_VERSION_1_2 && deviceProperties.apiVersion >= VK_API_VERSION_1_2 &&
+		hasDeviceExtension(physicalDevice, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) {
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &dynamicRenderingFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+		dynamicRenderingEnabled = dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+		dynamicRenderingFeatures.pNext = nullptr;
+	}
+	if (settings.dynamicRendering && !dynamicRenderingEnabled) {
+		std::cerr << "Dynamic rendering is not supported, using a render pass\n";
+	}
+
+	// Bindless textures need non-uniform indexing into a partially bound sampler array whose unused slots can be written
+	// after it was bound and while frames using it are pending
+	VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+	texturesEnabled = false;
+	if (settings.bindlessTextures && instanceApiVersion >= VK_API_VERSION_1_2 && deviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &indexingFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+		texturesEnabled = indexingFeatures.shaderSampledImageArrayNonUniformIndexing == VK_TRUE &&
+			indexingFeatures.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE &&
+			indexingFeatures.descriptorBindingUpdateUnusedWhilePending == VK_TRUE &&
+			indexingFeatures.descriptorBindingPartiallyBound == VK_TRUE &&
+			indexingFeatures.runtimeDescriptorArray == VK_TRUE;
+
+		// Only what TextureManager and textured.frag use
+		VkPhysicalDeviceDescriptorIndexingFeatures supported = indexingFeatures;
+		indexingFeatures = {};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		indexingFeatures.shaderSampledImageArrayNonUniformIndexing = supported.shaderSampledImageArrayNonUniformIndexing;
+		indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = supported.descriptorBindingSampledImageUpdateAfterBind;
+		indexingFeatures.descriptorBindingUpdateUnusedWhilePending = supported.descriptorBindingUpdateUnusedWhilePending;
+		indexingFeatures.descriptorBindingPartiallyBound = supported.descriptorBindingPartiallyBound;
+		indexingFeatures.runtimeDescriptorArray = supported.runtimeDescriptorArray;
+	}
+	if (settings.bindlessTextures && !texturesEnabled) {
+		std::cerr << "Descriptor indexing is not supported, drawing without textures\n";
+	}
+
+	// Without the draw count every group's draw is issued, the empty ones included
+	bool drawIndirectCount = gpuCullingEnabled && hasDeviceExtension(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	if (drawIndirectCount) {
+		extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	}
+
 	VkDeviceCreateInfo createInfo{};
+	if (timelineEnabled) {
+		createInfo.pNext = &timelineFeatures;
+	}
+	if (dynamicRenderingEnabled) {
+		extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+		dynamicRenderingFeatures.pNext = const_cast<void*>(createInfo.pNext);
+		createInfo.pNext = &dynamicRenderingFeatures;
+	}
+	if (texturesEnabled) {
+		indexingFeatures.pNext = const_cast<void*>(createInfo.pNext);
+		createInfo.pNext = &indexingFeatures;
+	}
 
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
 	if (enableValidationLayers) {
 		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -513,8 +1346,27 @@ void SwagkantApp::createLogicalDevice() {
 		throw std::runtime_error("Failed to create logical device!");
 	}
 
+	if (dynamicRenderingEnabled) {
+		cmdBeginRendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+		cmdEndRendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+		if (cmdBeginRendering == nullptr || cmdEndRendering == nullptr) {
+			throw std::runtime_error("Failed to load the dynamic rendering functions!");
+		}
+	}
+	if (drawIndirectCount) {
+		cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
+	}
+
 	vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
-	vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+	if (indices.presentFamily.has_value()) {
+		vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+	}
+	if (indices.transferFamily.has_value()) {
+		vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+	}
+	if (indices.computeFamily.has_value()) {
+		vkGetDeviceQueue(device, indices.computeFamily.value(), 0, &computeQueue);
+	}
 }
 
 /// <summary>
@@ -526,7 +1378,11 @@ void SwagkantApp::createSurface() {
 	}
 }
 
-void SwagkantApp::createSwapchain() {
+/// <summary>
+/// Creates the swap chain and gets its images
+/// </summary>
+/// <param name="oldSwapchain">The swap chain being replaced, its already queued images keep presenting while the new one comes up</param>
+void SwagkantApp::createSwapchain(VkSwapchainKHR oldSwapchain) {
 	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
 	VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -568,7 +1424,7 @@ void SwagkantApp::createSwapchain() {
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	createInfo.oldSwapchain = oldSwapchain;
 
 	if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
 		throw std::runtime_error("INGEN SWAP CHAINS!!!");
@@ -582,6 +1438,90 @@ void SwagkantApp::createSwapchain() {
 	swapChainExtent = extent;
 }
 
+/// <summary>
+/// Replaces the swap chain, its image views, framebuffers and render-done semaphores after a resize without waiting for the device.
+/// The old ones are handed to the deletion queue and destroyed once every frame submitted so far has completed.
+/// The surface format is assumed to stay the same, so the render pass and pipeline are kept.
+/// With dynamic rendering there are no framebuffers to rebuild
+/// </summary>
+void SwagkantApp::recreateSwapchain() {
+	framebufferResized = false;
+
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(window, &width, &height);
+	if (width == 0 || height == 0) {
+		// Minimized, drawFrame waits until the window comes back and the next present asks for a new swap chain
+		framebufferResized = true;
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	VkSwapchainKHR oldSwapchain = swapChain;
+	std::vector<VkImageView> oldImageViews = std::move(swapChainImageViews);
+	std::vector<VkFramebuffer> oldFramebuffers = std::move(swapChainFramebuffers);
+	std::vector<VkSemaphore> oldRenderDoneSemaphores = std::move(renderDoneSemaphores);
+	swapChainImageViews.clear();
+	swapChainFramebuffers.clear();
+	renderDoneSemaphores.clear();
+
+	createSwapchain(oldSwapchain);
+	createImageViews();
+	createFramebuffers();
+	createRenderDoneSemaphores();
+
+	deletionQueue.push(frameNumber, [this, oldSwapchain, oldImageViews, oldFramebuffers, oldRenderDoneSemaphores]() {
+		for (auto fb : oldFramebuffers) {
+			vkDestroyFramebuffer(device, fb, nullptr);
+		}
+		for (auto imageView : oldImageViews) {
+			vkDestroyImageView(device, imageView, nullptr);
+		}
+		for (auto semaphore : oldRenderDoneSemaphores) {
+			vkDestroySemaphore(device, semaphore, nullptr);
+		}
+		vkDestroySwapchainKHR(device, oldSwapchain, nullptr);
+	});
+
+	swapchainRecreated = true;
+	recreateStats.addFrame(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+/// <summary>
+/// Creates the device-owned images rendered to in headless mode, one per frame in flight.
+/// They take the place of the swap chain images, so image views, framebuffers and recordCommandBuffer are shared
+/// </summary>
+void SwagkantApp::createOffscreenImages() {
+	swapChainImageFormat = OFFSCREEN_FORMAT;
+	swapChainExtent = { WIDTH, HEIGHT };
+
+	offscreenImages.resize(settings.framesInFlight);
+	offscreenImageMemory.resize(settings.framesInFlight);
+
+	for (uint32_t i = 0; i < settings.framesInFlight; i++) {
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = swapChainImageFormat;
+		imageInfo.extent = { swapChainExtent.width, swapChainExtent.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		if (vkCreateImage(device, &imageInfo, nullptr, &offscreenImages[i]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create offscreen image!");
+		}
+
+		offscreenImageMemory[i] = allocator.allocateImage(offscreenImages[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageInfo.tiling);
+	}
+
+	swapChainImages = offscreenImages;
+}
+
 void SwagkantApp::createImageViews() {
 	if (device == VK_NULL_HANDLE) {
 		throw std::runtime_error("Device er squ NULL... v");
@@ -623,7 +1563,12 @@ void SwagkantApp::createImageViews() {
 	}
 }
 
+/// <summary>
+/// Creates the render pass clearing and drawing the color attachment, dynamic rendering doesn't use one
+/// </summary>
 void SwagkantApp::createRenderPass() {
+	if (dynamicRenderingEnabled) { return; }
+
 	VkAttachmentDescription colorAttachment{};
 	colorAttachment.format = swapChainImageFormat;
 	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -633,7 +1578,8 @@ void SwagkantApp::createRenderPass() {
 	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	// Offscreen images are left ready to be copied out instead of presented
+	colorAttachment.finalLayout = settings.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	VkAttachmentReference colorAttachmentRef{};
 	colorAttachmentRef.attachment = 0;
@@ -644,13 +1590,8 @@ void SwagkantApp::createRenderPass() {
 	subpass.colorAttachmentCount = 1;
 	subpass.pColorAttachments = &colorAttachmentRef;
 
-	VkSubpassDependency dependency{};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	// The same usages the frame graph is given, so it can leave the image's first barrier to the render pass
+	VkSubpassDependency dependency = RenderGraph::externalDependency(SWAPCHAIN_ACQUIRE_USAGE, COLOR_ATTACHMENT_USAGE);
 
 	VkRenderPassCreateInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -667,12 +1608,13 @@ void SwagkantApp::createRenderPass() {
 	}
 }
 
+/// <summary>
+/// Creates a graphics pipeline per PipelineVariant in one vkCreateGraphicsPipelines call.
+/// They share everything but the specialization constants, so the driver compiles branch free shaders for each
+/// </summary>
 void SwagkantApp::createGraphicsPipeline() {
-	auto vertShaderCode = IOHelper::readFile("shader.vert.spv");
-	auto fragShaderCode = IOHelper::readFile("shader.frag.spv");
-
-	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-	VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+	VkShaderModule vertShaderModule = createShaderModule(ShaderRegistry::get("shader.vert"));
+	VkShaderModule fragShaderModule = createShaderModule(ShaderRegistry::get(texturesEnabled ? "textured.frag" : "shader.frag"));
 
 	// Create pipeline layout
 	VkPipelineShaderStageCreateInfo vertShaderCreateInfo{};
@@ -692,10 +1634,26 @@ void SwagkantApp::createGraphicsPipeline() {
 		fragShaderCreateInfo
 	};
 
+	// Binding 0 is the quad, binding 1 the per instance data
+	std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = {
+		Vertex::getBindingDescription(),
+		InstanceData::getBindingDescription()
+	};
+
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+	for (const auto& attribute : Vertex::getAttributeDescriptions()) {
+		attributeDescriptions.push_back(attribute);
+	}
+	for (const auto& attribute : InstanceData::getAttributeDescriptions()) {
+		attributeDescriptions.push_back(attribute);
+	}
+
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 0;
-	vertexInputInfo.vertexAttributeDescriptionCount = 0;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
 	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -752,13 +1710,36 @@ void SwagkantApp::createGraphicsPipeline() {
 
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 0;
-	pipelineLayoutInfo.pushConstantRangeCount = 0;
+	std::vector<VkDescriptorSetLayout> setLayouts = { uniformRing.getSetLayout() };
+	if (texturesEnabled) {
+		setLayouts.push_back(textureManager.getSetLayout());
+	}
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(DrawConstants);
+
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
 	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create pipeline layout!");
 	}
 
+	// Every variant gets its own copy of the stages, pointing at its specialization info
+	std::array<VkSpecializationInfo, PIPELINE_VARIANTS.size()> specializationInfos;
+	std::array<std::array<VkPipelineShaderStageCreateInfo, 2>, PIPELINE_VARIANTS.size()> variantStages;
+	for (size_t i = 0; i < PIPELINE_VARIANTS.size(); i++) {
+		specializationInfos[i] = getSpecializationInfo(PIPELINE_VARIANTS[i].variant);
+		for (size_t stage = 0; stage < shaderStages.size(); stage++) {
+			variantStages[i][stage] = shaderStages[stage];
+			variantStages[i][stage].pSpecializationInfo = &specializationInfos[i];
+		}
+	}
+
 	//Create pipeline
 	VkGraphicsPipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -775,124 +1756,1335 @@ void SwagkantApp::createGraphicsPipeline() {
 	pipelineInfo.pColorBlendState = &colorBlending;
 	pipelineInfo.pDynamicState = &dynamicState;
 
+	// Without a render pass the pipeline is told the attachment formats instead
+	VkPipelineRenderingCreateInfoKHR renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachmentFormats = &swapChainImageFormat;
+
+	pipelineInfo.pNext = dynamicRenderingEnabled ? &renderingInfo : nullptr;
 	pipelineInfo.layout = pipelineLayout;
 	pipelineInfo.renderPass = renderPass;
 	pipelineInfo.subpass = 0;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.basePipelineIndex = -1;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create graphics pipeline!");
+	std::array<VkGraphicsPipelineCreateInfo, PIPELINE_VARIANTS.size()> pipelineInfos;
+	for (size_t i = 0; i < PIPELINE_VARIANTS.size(); i++) {
+		pipelineInfos[i] = pipelineInfo;
+		pipelineInfos[i].pStages = variantStages[i].data();
+	}
+
+	auto pipelineStart = std::chrono::steady_clock::now();
+	if (vkCreateGraphicsPipelines(device, pipelineCache.get(), static_cast<uint32_t>(pipelineInfos.size()), pipelineInfos.data(), nullptr,
+		graphicsPipelines.data()) != VK_SUCCESS) {
+		// A failed batch may still have created some of the pipelines, the rest are left null
+		for (auto& pipeline : graphicsPipelines) {
+			if (pipeline != VK_NULL_HANDLE) {
+				vkDestroyPipeline(device, pipeline, nullptr);
+				pipeline = VK_NULL_HANDLE;
+			}
+		}
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		pipelineLayout = VK_NULL_HANDLE;
+		vkDestroyShaderModule(device, vertShaderModule, nullptr);
+		vkDestroyShaderModule(device, fragShaderModule, nullptr);
+		throw std::runtime_error("Failed to create graphics pipelines!");
 	}
+	pipelineCreationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipelineStart).count();
 
 	vkDestroyShaderModule(device, vertShaderModule, nullptr);
 	vkDestroyShaderModule(device, fragShaderModule, nullptr);
 }
 
-void SwagkantApp::createFramebuffers() {
-	swapChainFramebuffers.resize(swapChainImageViews.size());
+/// <summary>
+/// Creates the compute pipeline animating the instances, with a storage buffer descriptor per frame slot
+/// and the time and instance grid as push constants
+/// </summary>
+void SwagkantApp::createComputePipeline() {
+	VkDescriptorSetLayoutBinding instancesBinding{};
+	instancesBinding.binding = 0;
+	instancesBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	instancesBinding.descriptorCount = 1;
+	instancesBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &instancesBinding;
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &computeSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute descriptor set layout!");
+	}
 
-	for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-		VkImageView attachments[] = {
-			swapChainImageViews[i]
-		};
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(float) + 3 * sizeof(uint32_t);
 
-		VkFramebufferCreateInfo framebufferInfo{};
-		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferInfo.renderPass = renderPass;
-		framebufferInfo.attachmentCount = 1;
-		framebufferInfo.pAttachments = attachments;
-		framebufferInfo.width = swapChainExtent.width;
-		framebufferInfo.height = swapChainExtent.height;
-		framebufferInfo.layers = 1;
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &computeSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-		if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("Kunne ikke lave framebuffer'en :(");
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &computePipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute pipeline layout!");
+	}
+
+	VkShaderModule compShaderModule = createShaderModule(ShaderRegistry::get("instances.comp"));
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = compShaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = computePipelineLayout;
+
+	if (vkCreateComputePipelines(device, pipelineCache.get(), 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute pipeline!");
+	}
+
+	vkDestroyShaderModule(device, compShaderModule, nullptr);
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = settings.framesInFlight;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = settings.framesInFlight;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &computeDescriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(settings.framesInFlight, computeSetLayout);
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = computeDescriptorPool;
+	allocInfo.descriptorSetCount = settings.framesInFlight;
+	allocInfo.pSetLayouts = layouts.data();
+
+	computeDescriptorSets.resize(settings.framesInFlight);
+	if (vkAllocateDescriptorSets(device, &allocInfo, computeDescriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate compute descriptor sets!");
+	}
+}
+
+/// <summary>
+/// Starts streaming the textures given on the command line, or creates the procedural textures the instances cycle through
+/// otherwise: a checkerboard, a cut-out circle, a ring and stripes. The cut-outs are transparent, so the alpha-tested variant shows through them
+/// </summary>
+void SwagkantApp::createTextures() {
+	if (!settings.texturePaths.empty()) {
+		for (const auto& path : settings.texturePaths) {
+			textureStreamer.load(path);
 		}
+		return;
 	}
+
+	constexpr uint32_t size = 64;
+	std::vector<uint32_t> pixels(size * size);
+
+	auto fill = [&](auto texel) {
+		for (uint32_t y = 0; y < size; y++) {
+			for (uint32_t x = 0; x < size; x++) {
+				float u = (x + 0.5f) / size * 2.0f - 1.0f;
+				float v = (y + 0.5f) / size * 2.0f - 1.0f;
+				pixels[y * size + x] = texel(x, y, std::sqrt(u * u + v * v));
+			}
+		}
+		textureManager.createTexture(size, size, pixels.data());
+	};
+
+	// Packed as RGBA8 in memory, so 0xAABBGGRR on little endian
+	constexpr uint32_t white = 0xFFFFFFFF, grey = 0xFF808080, clear = 0x00000000;
+	fill([&](uint32_t x, uint32_t y, float) { return ((x / 8 + y / 8) % 2) ? white : grey; });
+	fill([&](uint32_t, uint32_t, float r) { return r < 0.9f ? white : clear; });
+	fill([&](uint32_t, uint32_t, float r) { return r > 0.5f && r < 0.9f ? white : clear; });
+	fill([&](uint32_t x, uint32_t, float) { return (x / 8) % 2 ? white : clear; });
+
+#ifndef NDEBUG
+	std::cout << "Created " << textureManager.count() << " bindless textures\n";
+#endif // !NDEBUG
 }
 
-void SwagkantApp::createCommandPool() {
+/// <summary>
+/// Creates the compute command pool on the compute family, a command buffer and a compute-done semaphore per frame slot
+/// </summary>
+void SwagkantApp::createComputeCommandBuffers() {
 	QueueFamilyIndices familyIndices = findQueueFamilies(physicalDevice);
 
 	VkCommandPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-	poolInfo.queueFamilyIndex = familyIndices.graphicsFamily.value();
+	poolInfo.queueFamilyIndex = familyIndices.computeFamily.value();
 
-	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
-		throw std::runtime_error("No bathing in the pool :(");
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &computeCommandPool) != VK_SUCCESS) {
+		throw std::runtime_error("No bathing in the compute pool :(");
 	}
-}
 
-void SwagkantApp::createCommandBuffer() {
-	VkCommandBufferAllocateInfo bufferInfo{};
-	bufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	bufferInfo.commandPool = commandPool;
-	bufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	bufferInfo.commandBufferCount = 1;
+	computeCommandBuffers.resize(settings.framesInFlight);
 
-	if (vkAllocateCommandBuffers(device, &bufferInfo, &commandBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("Kunne ikke allokerer command buffers!");
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = computeCommandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = settings.framesInFlight;
+
+	if (vkAllocateCommandBuffers(device, &allocInfo, computeCommandBuffers.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Kunne ikke allokerer compute command buffers!");
 	}
-}
 
-void SwagkantApp::createSyncObjects() {
 	VkSemaphoreCreateInfo semaphoreInfo{};
-	VkFenceCreateInfo fenceInfo{};
-
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageReadySemaphore) != VK_SUCCESS ||
-		vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderDoneSemaphore) != VK_SUCCESS ||
-		vkCreateFence(device, &fenceInfo, nullptr, &flightFence) != VK_SUCCESS) {
-		throw std::runtime_error("Kunne ikke lave fence og semaphores!");
+	computeDoneSemaphores.resize(settings.framesInFlight);
+	for (auto& semaphore : computeDoneSemaphores) {
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("Kunne ikke lave compute semaphores!");
+		}
 	}
 }
 
-void SwagkantApp::recordCommandBuffer(VkCommandBuffer comBuffer, uint32_t imageIndex) {
+/// <summary>
+/// Creates an instance buffer per frame slot for the compute shader to write, and points the slots' descriptor sets at them.
+/// They're shared concurrently between the compute and graphics families, so no ownership transfers are needed every frame
+/// </summary>
+void SwagkantApp::createAnimatedInstanceBuffers() {
+	destroyAnimatedInstanceBuffers();
+
+	QueueFamilyIndices familyIndices = findQueueFamilies(physicalDevice);
+	std::vector<uint32_t> queueFamilies = { familyIndices.graphicsFamily.value() };
+	if (familyIndices.computeFamily != familyIndices.graphicsFamily) {
+		queueFamilies.push_back(familyIndices.computeFamily.value());
+	}
+
+	VkDeviceSize bufferSize = sizeof(InstanceData) * drawInstanceCount;
+	animatedInstanceBuffers.resize(settings.framesInFlight);
+	animatedInstanceMemory.resize(settings.framesInFlight);
+
+	for (uint32_t i = 0; i < settings.framesInFlight; i++) {
+		createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			animatedInstanceBuffers[i], animatedInstanceMemory[i], AllocationStrategy::Buddy, queueFamilies);
+
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = animatedInstanceBuffers[i];
+		bufferInfo.offset = 0;
+		bufferInfo.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = computeDescriptorSets[i];
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pBufferInfo = &bufferInfo;
+
+		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+	}
+}
+
+/// <summary>
+/// Queues the animated instance buffers for deletion once the next frame has completed, like the instance buffer they replace
+/// </summary>
+void SwagkantApp::destroyAnimatedInstanceBuffers() {
+	if (animatedInstanceBuffers.empty()) { return; }
+
+	deletionQueue.push(frameNumber + 1, [this, buffers = std::move(animatedInstanceBuffers), memory = std::move(animatedInstanceMemory)]() mutable {
+		for (size_t i = 0; i < buffers.size(); i++) {
+			vkDestroyBuffer(device, buffers[i], nullptr);
+			allocator.free(memory[i]);
+		}
+	});
+
+	animatedInstanceBuffers.clear();
+	animatedInstanceMemory.clear();
+}
+
+/// <summary>
+/// Records and submits the instance animation of the current frame slot. The slot's buffer was last read by the frame
+/// whose fence was just waited on, so the compute queue can start writing it right away.
+/// The frame's graphics submit waits on the compute-done semaphore before reading it as vertex input
+/// </summary>
+void SwagkantApp::submitCompute(std::vector<VkSemaphore>& waitSemaphores, std::vector<VkPipelineStageFlags>& waitStages) {
+	VkCommandBuffer comBuffer = computeCommandBuffers[currentFrame];
+	vkResetCommandBuffer(comBuffer, 0);
+
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = 0;
-	beginInfo.pInheritanceInfo = nullptr;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 	if (vkBeginCommandBuffer(comBuffer, &beginInfo) != VK_SUCCESS) {
-		throw std::runtime_error("Kunne ikke begynde at optage command buffers!");
+		throw std::runtime_error("Kunne ikke begynde at optage compute command buffer!");
 	}
 
-	VkRenderPassBeginInfo renderPassInfo{};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = renderPass;
-	renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
-	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = swapChainExtent;
+	struct {
+		float time;
+		uint32_t count;
+		uint32_t side;
+		uint32_t textureCount;
+	} params;
+	params.time = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+	params.count = drawInstanceCount;
+	params.side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(drawInstanceCount))));
+	params.textureCount = texturesEnabled ? textureManager.count() : 0;
+
+	vkCmdBindPipeline(comBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+	vkCmdBindDescriptorSets(comBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &computeDescriptorSets[currentFrame], 0, nullptr);
+	vkCmdPushConstants(comBuffer, computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+	vkCmdDispatch(comBuffer, (drawInstanceCount + 63) / 64, 1, 1);
 
-	VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
-	renderPassInfo.clearValueCount = 1;
-	renderPassInfo.pClearValues = &clearColor;
+	if (vkEndCommandBuffer(comBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Kunne ikke optage compute command buffer!");
+	}
 
-	vkCmdBeginRenderPass(comBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(comBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	// On the timeline path the compute timeline reaches N + 1 with frame N, the graphics submit waits for that value
+	VkSemaphore doneSemaphore = timelineEnabled ? computeTimeline : computeDoneSemaphores[currentFrame];
+	uint64_t doneValue = frameNumber + 1;
 
-	VkViewport view{};
-	view.x = view.y = 0.0f;
-	view.width = static_cast<float>(swapChainExtent.width);
-	view.height = static_cast<float>(swapChainExtent.height);
-	view.minDepth = 0.0f;
-	view.maxDepth = 1.0f;
-	vkCmdSetViewport(comBuffer, 0, 1, &view);
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &doneValue;
 
-	VkRect2D scissor{};
-	scissor.offset = { 0, 0 };
-	scissor.extent = swapChainExtent;
-	vkCmdSetScissor(comBuffer, 0, 1, &scissor);
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = timelineEnabled ? &timelineInfo : nullptr;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &comBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &doneSemaphore;
 
-	vkCmdDraw(comBuffer, 6, 1, 0, 0);
-	vkCmdEndRenderPass(comBuffer);
+	if (vkQueueSubmit(computeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit compute command buffer!");
+	}
 
-	if (vkEndCommandBuffer(comBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("Kunne ikke optage command buffer!");
+	// The semaphore wait also makes the shader writes visible to the vertex input, or to the culling pass reading them first
+	waitSemaphores.push_back(doneSemaphore);
+	waitStages.push_back(gpuCullingEnabled ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+}
+
+/// <summary>
+/// Destroys everything created for the compute animation, the device must be idle
+/// </summary>
+void SwagkantApp::destroyCompute() {
+	if (computePipeline == VK_NULL_HANDLE) { return; }
+
+	for (auto semaphore : computeDoneSemaphores) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	vkDestroyCommandPool(device, computeCommandPool, nullptr);
+	vkDestroyDescriptorPool(device, computeDescriptorPool, nullptr);
+	vkDestroyPipeline(device, computePipeline, nullptr);
+	vkDestroyPipelineLayout(device, computePipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, computeSetLayout, nullptr);
+}
+
+/// <summary>
+/// Creates the culling pipeline with a descriptor set per frame slot: the instances to cull, the compacted visible
+/// instances and the indirect draws. The frame uniforms come from the uniform ring as set 0, like in the graphics pipeline
+/// </summary>
+void SwagkantApp::createCullPipeline() {
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &cullSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create culling descriptor set layout!");
+	}
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = 2 * sizeof(uint32_t);
+
+	VkDescriptorSetLayout setLayouts[] = { uniformRing.getSetLayout(), cullSetLayout };
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 2;
+	pipelineLayoutInfo.pSetLayouts = setLayouts;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create culling pipeline layout!");
+	}
+
+	VkShaderModule cullShaderModule = createShaderModule(ShaderRegistry::get("cull.comp"));
+
+	// DRAW_COUNT, whether the draws are appended and counted for vkCmdDrawIndexedIndirectCount
+	VkBool32 drawCount = cmdDrawIndexedIndirectCount != nullptr ? VK_TRUE : VK_FALSE;
+	VkSpecializationMapEntry drawCountEntry{ 0, 0, sizeof(VkBool32) };
+	VkSpecializationInfo specializationInfo{};
+	specializationInfo.mapEntryCount = 1;
+	specializationInfo.pMapEntries = &drawCountEntry;
+	specializationInfo.dataSize = sizeof(VkBool32);
+	specializationInfo.pData = &drawCount;
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = cullShaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+	pipelineInfo.layout = cullPipelineLayout;
+
+	if (vkCreateComputePipelines(device, pipelineCache.get(), 1, &pipelineInfo, nullptr, &cullPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create culling pipeline!");
+	}
+
+	vkDestroyShaderModule(device, cullShaderModule, nullptr);
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = static_cast<uint32_t>(bindings.size()) * settings.framesInFlight;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = settings.framesInFlight;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &cullDescriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create culling descriptor pool!");
 	}
+
+	std::vector<VkDescriptorSetLayout> layouts(settings.framesInFlight, cullSetLayout);
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = cullDescriptorPool;
+	allocInfo.descriptorSetCount = settings.framesInFlight;
+	allocInfo.pSetLayouts = layouts.data();
+
+	cullDescriptorSets.resize(settings.framesInFlight);
+	if (vkAllocateDescriptorSets(device, &allocInfo, cullDescriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate culling descriptor sets!");
+	}
+}
+
+/// <summary>
+/// Creates the visible instance and indirect buffers of every frame slot for the current instance count,
+/// and points the slots' descriptor sets at them and at the instances they cull
+/// </summary>
+void SwagkantApp::createCullBuffers() {
+	destroyCullBuffers();
+
+	uint32_t groups = (drawInstanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE;
+	VkDeviceSize visibleSize = sizeof(InstanceData) * groups * CULL_GROUP_SIZE;
+	VkDeviceSize indirectSize = INDIRECT_DRAWS_OFFSET + sizeof(VkDrawIndexedIndirectCommand) * groups;
+
+	visibleInstanceBuffers.resize(settings.framesInFlight);
+	visibleInstanceMemory.resize(settings.framesInFlight);
+	indirectBuffers.resize(settings.framesInFlight);
+	indirectMemory.resize(settings.framesInFlight);
+
+	for (uint32_t i = 0; i < settings.framesInFlight; i++) {
+		createBuffer(visibleSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			visibleInstanceBuffers[i], visibleInstanceMemory[i]);
+		createBuffer(indirectSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indirectBuffers[i], indirectMemory[i]);
+
+		VkBuffer instances = settings.computeInstances ? animatedInstanceBuffers[i] : instanceBuffer;
+		if (sceneEnabled) {
+			instances = sceneInstanceBuffers[i];
+		}
+		std::array<VkDescriptorBufferInfo, 3> bufferInfos = { {
+			{ instances, 0, VK_WHOLE_SIZE },
+			{ visibleInstanceBuffers[i], 0, VK_WHOLE_SIZE },
+			{ indirectBuffers[i], 0, VK_WHOLE_SIZE },
+		} };
+
+		std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+		for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+			descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[binding].dstSet = cullDescriptorSets[i];
+			descriptorWrites[binding].dstBinding = binding;
+			descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[binding].descriptorCount = 1;
+			descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+/// <summary>
+/// Destroys the culling buffers, the GPU must be done with them
+/// </summary>
+void SwagkantApp::destroyCullBuffers() {
+	for (size_t i = 0; i < visibleInstanceBuffers.size(); i++) {
+		vkDestroyBuffer(device, visibleInstanceBuffers[i], nullptr);
+		allocator.free(visibleInstanceMemory[i]);
+		vkDestroyBuffer(device, indirectBuffers[i], nullptr);
+		allocator.free(indirectMemory[i]);
+	}
+
+	visibleInstanceBuffers.clear();
+	visibleInstanceMemory.clear();
+	indirectBuffers.clear();
+	indirectMemory.clear();
+}
+
+/// <summary>
+/// Adds the culling passes of the frame slot to the frame graph, which puts the barriers between them and the draws.
+/// The CPU cost is the same whatever the instance count, the GPU decides what gets drawn
+/// </summary>
+void SwagkantApp::addCullingPasses(RenderGraph::ResourceId indirect, RenderGraph::ResourceId visible) {
+	bool counted = cmdDrawIndexedIndirectCount != nullptr;
+
+	if (counted) {
+		// The slot's previous frame has completed, so only the count reset has to land before the shader
+		RenderGraph::PassId reset = frameGraph.addPass("reset draw count", [this](VkCommandBuffer comBuffer) {
+			vkCmdFillBuffer(comBuffer, indirectBuffers[currentFrame], 0, sizeof(uint32_t), 0);
+		});
+		frameGraph.write(reset, indirect, { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT });
+	}
+
+	RenderGraph::PassId cull = frameGraph.addPass("cull", [this](VkCommandBuffer comBuffer) {
+		struct {
+			uint32_t count;
+			uint32_t indexCount;
+		} params;
+		params.count = drawInstanceCount;
+		params.indexCount = static_cast<uint32_t>(quadIndices.size());
+
+		VkDescriptorSet sets[] = { uniformRing.getSet(), cullDescriptorSets[currentFrame] };
+		vkCmdBindPipeline(comBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+		vkCmdBindDescriptorSets(comBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 2, sets, 1, &frameDataOffset);
+		vkCmdPushConstants(comBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+		vkCmdDispatch(comBuffer, (drawInstanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	});
+	// The draw count is incremented atomically, so it is read as well
+	VkAccessFlags indirectAccess = VK_ACCESS_SHADER_WRITE_BIT | (counted ? VK_ACCESS_SHADER_READ_BIT : 0);
+	frameGraph.write(cull, indirect, { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, indirectAccess });
+	frameGraph.write(cull, visible, { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT });
+}
+
+/// <summary>
+/// Destroys everything created for GPU culling, the device must be idle
+/// </summary>
+void SwagkantApp::destroyCulling() {
+	if (cullPipeline == VK_NULL_HANDLE) { return; }
+
+	destroyCullBuffers();
+	vkDestroyDescriptorPool(device, cullDescriptorPool, nullptr);
+	vkDestroyPipeline(device, cullPipeline, nullptr);
+	vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, cullSetLayout, nullptr);
+}
+
+/// <summary>
+/// Creates a host visible buffer per frame slot for the visible instances, which the CPU culling writes every frame
+/// </summary>
+void SwagkantApp::createCulledInstanceBuffers() {
+	destroyCulledInstanceBuffers();
+
+	culledInstanceBuffers.resize(settings.framesInFlight);
+	culledInstanceMemory.resize(settings.framesInFlight);
+	for (uint32_t i = 0; i < settings.framesInFlight; i++) {
+		createBuffer(sizeof(InstanceData) * cpuInstances.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, culledInstanceBuffers[i], culledInstanceMemory[i]);
+	}
+}
+
+/// <summary>
+/// Destroys the culled instance buffers, the GPU must be done with them
+/// </summary>
+void SwagkantApp::destroyCulledInstanceBuffers() {
+	for (size_t i = 0; i < culledInstanceBuffers.size(); i++) {
+		vkDestroyBuffer(device, culledInstanceBuffers[i], nullptr);
+		allocator.free(culledInstanceMemory[i]);
+	}
+
+	culledInstanceBuffers.clear();
+	culledInstanceMemory.clear();
+	culledInstanceCount = 0;
+}
+
+/// <summary>
+/// Culls the instances against the view and copies the visible ones into the frame slot's buffer,
+/// which the slot's previous frame is done reading
+/// </summary>
+void SwagkantApp::cullInstances(const glm::mat4& viewProjection) {
+	std::span<const uint32_t> visible = frustumCuller.cull(viewProjection);
+
+	auto culled = static_cast<InstanceData*>(culledInstanceMemory[currentFrame].mapped);
+	for (size_t i = 0; i < visible.size(); i++) {
+		culled[i] = cpuInstances[visible[i]];
+	}
+	culledInstanceCount = static_cast<uint32_t>(visible.size());
+}
+
+/// <summary>
+/// Builds a two level hierarchy over the grid, the first cell of every SCENE_CLUSTER_SIZE square block of cells is the
+/// parent of the rest of its block. The children are placed in their parent's space, so a spinning parent swings them
+/// around itself. Row major indices put every parent ahead of its children, as the scene requires
+/// </summary>
+void SwagkantApp::buildScene(const std::vector<InstanceData>& instances, uint32_t side) {
+	scene.clear();
+	scene.reserve(static_cast<uint32_t>(instances.size()));
+	spinningNodes.clear();
+
+	uint32_t clustersPerRow = (side + SCENE_CLUSTER_SIZE - 1) / SCENE_CLUSTER_SIZE;
+	for (uint32_t i = 0; i < instances.size(); i++) {
+		uint32_t x = i % side;
+		uint32_t y = i / side;
+		uint32_t hub = (y - y % SCENE_CLUSTER_SIZE) * side + (x - x % SCENE_CLUSTER_SIZE);
+
+		const InstanceData& instance = instances[i];
+		if (hub == i) {
+			scene.addNode(Scene::NO_PARENT, { instance.offset.x, instance.offset.y, 0.0f }, 0.0f, { instance.scale.x, instance.scale.y, 1.0f });
+
+			uint32_t cluster = (y / SCENE_CLUSTER_SIZE) * clustersPerRow + x / SCENE_CLUSTER_SIZE;
+			if (cluster % SCENE_SPIN_STRIDE == 0) {
+				spinningNodes.push_back(i);
+			}
+			continue;
+		}
+
+		const InstanceData& parent = instances[hub];
+		glm::vec3 translation((instance.offset.x - parent.offset.x) / parent.scale.x, (instance.offset.y - parent.offset.y) / parent.scale.y, 0.0f);
+		scene.addNode(hub, translation, 0.0f, { instance.scale.x / parent.scale.x, instance.scale.y / parent.scale.y, 1.0f });
+	}
+}
+
+/// <summary>
+/// Creates a host visible buffer per frame slot holding the scene's instances, the scene writes the transforms into it
+/// </summary>
+void SwagkantApp::createSceneInstanceBuffers(const std::vector<InstanceData>& instances) {
+	destroySceneInstanceBuffers();
+
+	VkDeviceSize bufferSize = sizeof(InstanceData) * instances.size();
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | (gpuCullingEnabled ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0);
+
+	sceneInstanceBuffers.resize(settings.framesInFlight);
+	sceneInstanceMemory.resize(settings.framesInFlight);
+	sceneSlotVersions.assign(settings.framesInFlight, 0);
+	for (uint32_t i = 0; i < settings.framesInFlight; i++) {
+		createBuffer(bufferSize, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			sceneInstanceBuffers[i], sceneInstanceMemory[i]);
+
+		// The colors and textures never change, version 0 makes the first update write every transform
+		std::memcpy(sceneInstanceMemory[i].mapped, instances.data(), bufferSize);
+	}
+}
+
+/// <summary>
+/// Destroys the scene's instance buffers, the GPU must be done with them
+/// </summary>
+void SwagkantApp::destroySceneInstanceBuffers() {
+	for (size_t i = 0; i < sceneInstanceBuffers.size(); i++) {
+		vkDestroyBuffer(device, sceneInstanceBuffers[i], nullptr);
+		allocator.free(sceneInstanceMemory[i]);
+	}
+
+	sceneInstanceBuffers.clear();
+	sceneInstanceMemory.clear();
+	sceneSlotVersions.clear();
+}
+
+/// <summary>
+/// Spins a part of the clusters and updates the scene, then writes the transforms that changed since the frame slot's
+/// buffer was last written. The slot's previous frame is done reading it
+/// </summary>
+void SwagkantApp::updateScene() {
+	auto start = std::chrono::steady_clock::now();
+
+	float angle = static_cast<float>(frameNumber) * SCENE_SPIN_SPEED;
+	for (uint32_t node : spinningNodes) {
+		scene.setRotation(node, angle);
+	}
+	sceneRecomputedNodes = scene.update();
+
+	scene.writeInstances(static_cast<InstanceData*>(sceneInstanceMemory[currentFrame].mapped), sceneSlotVersions[currentFrame]);
+	sceneSlotVersions[currentFrame] = scene.getVersion();
+
+	sceneStats.addFrame(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+/// <summary>
+/// Creates a framebuffer per swap chain image view, dynamic rendering uses the image views directly
+/// </summary>
+void SwagkantApp::createFramebuffers() {
+	if (dynamicRenderingEnabled) { return; }
+
+	swapChainFramebuffers.resize(swapChainImageViews.size());
+
+	for (size_t i = 0; i < swapChainImageViews.size(); i++) {
+		VkImageView attachments[] = {
+			swapChainImageViews[i]
+		};
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = renderPass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = attachments;
+		framebufferInfo.width = swapChainExtent.width;
+		framebufferInfo.height = swapChainExtent.height;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
+			throw std::runtime_error("Kunne ikke lave framebuffer'en :(");
+		}
+	}
+}
+
+void SwagkantApp::createCommandPool() {
+	QueueFamilyIndices familyIndices = findQueueFamilies(physicalDevice);
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = familyIndices.graphicsFamily.value();
+
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("No bathing in the pool :(");
+	}
+}
+
+/// <summary>
+/// Uploads the quad vertices into a device local vertex buffer
+/// </summary>
+void SwagkantApp::createVertexBuffer() {
+	VkDeviceSize bufferSize = sizeof(quadVertices[0]) * quadVertices.size();
+	uploadToDeviceLocalBuffer(quadVertices.data(), bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer, vertexBufferMemory);
+}
+
+/// <summary>
+/// Uploads the quad indices into a device local index buffer
+/// </summary>
+void SwagkantApp::createIndexBuffer() {
+	VkDeviceSize bufferSize = sizeof(quadIndices[0]) * quadIndices.size();
+	uploadToDeviceLocalBuffer(quadIndices.data(), bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexBuffer, indexBufferMemory);
+}
+
+/// <summary>
+/// Uploads count quad instances laid out in a square grid covering the screen, replacing the previous instance buffer.
+/// A single instance covers the same area as the quad without instancing
+/// </summary>
+void SwagkantApp::createInstanceBuffer(uint32_t count) {
+	destroyInstanceBuffer();
+
+	count = std::max(count, 1u);
+	uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+	float cell = 2.0f / static_cast<float>(side);
+
+	uint32_t textureCount = texturesEnabled ? textureManager.count() : 0;
+
+	std::vector<InstanceData> instances(count);
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t x = i % side;
+		uint32_t y = i / side;
+		float u = side > 1 ? static_cast<float>(x) / static_cast<float>(side - 1) : 0.0f;
+		float v = side > 1 ? static_cast<float>(y) / static_cast<float>(side - 1) : 0.0f;
+
+		instances[i].offset = { -1.0f + cell * (x + 0.5f), -1.0f + cell * (y + 0.5f) };
+		instances[i].scale = { cell * 0.5f, cell * 0.5f };
+		instances[i].color = { 1.0f - 0.5f * u, 1.0f - 0.5f * v, 1.0f };
+		instances[i].textureIndex = textureCount > 0 ? i % textureCount : 0;
+	}
+
+	VkDeviceSize bufferSize = sizeof(instances[0]) * instances.size();
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | (gpuCullingEnabled ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0);
+	uploadToDeviceLocalBuffer(instances.data(), bufferSize, usage, instanceBuffer, instanceBufferMemory);
+	drawInstanceCount = count;
+
+	if (settings.computeInstances) {
+		createAnimatedInstanceBuffers();
+	}
+	if (sceneEnabled) {
+		buildScene(instances, side);
+		createSceneInstanceBuffers(instances);
+	}
+	if (gpuCullingEnabled) {
+		createCullBuffers();
+	}
+	if (cpuCullingEnabled) {
+		// Bounding spheres of the quads, at the depth shader.vert places them
+		frustumCuller.reserve(count);
+		for (const auto& instance : instances) {
+			frustumCuller.add({ instance.offset.x, instance.offset.y, 1.0f }, 0.5f * std::hypot(instance.scale.x, instance.scale.y));
+		}
+		cpuInstances = std::move(instances);
+		createCulledInstanceBuffers();
+	}
+}
+
+/// <summary>
+/// Destroys the instance buffer and everything built on it, the GPU must be done with the frames that used them.
+/// The instance buffer itself is only queued for deletion: its upload may still sit in the uploader's open batch,
+/// which the next frame submits and acquires, so it can only go once that frame has completed
+/// </summary>
+void SwagkantApp::destroyInstanceBuffer() {
+	if (instanceBuffer == VK_NULL_HANDLE) { return; }
+
+	deletionQueue.push(frameNumber + 1, [this, buffer = instanceBuffer, memory = instanceBufferMemory]() mutable {
+		vkDestroyBuffer(device, buffer, nullptr);
+		allocator.free(memory);
+	});
+	instanceBuffer = VK_NULL_HANDLE;
+	drawInstanceCount = 0;
+
+	destroyAnimatedInstanceBuffers();
+	destroyCullBuffers();
+	destroyCulledInstanceBuffers();
+	frustumCuller.clear();
+	cpuInstances.clear();
+	destroySceneInstanceBuffers();
+	scene.clear();
+}
+
+/// <summary>
+/// Allocates one primary command buffer per frame in flight
+/// </summary>
+void SwagkantApp::createCommandBuffers() {
+	commandBuffers.resize(settings.framesInFlight);
+
+	VkCommandBufferAllocateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	bufferInfo.commandPool = commandPool;
+	bufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	bufferInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+	if (vkAllocateCommandBuffers(device, &bufferInfo, commandBuffers.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Kunne ikke allokerer command buffers!");
+	}
+}
+
+/// <summary>
+/// Creates a command pool and a secondary command buffer per frame slot and recording thread.
+/// Every thread owns its pools, so they're recorded without any locking
+/// </summary>
+void SwagkantApp::createSecondaryCommandBuffers() {
+	QueueFamilyIndices familyIndices = findQueueFamilies(physicalDevice);
+	uint32_t threads = recordPool.size();
+
+	secondaryCommandPools.resize(settings.framesInFlight);
+	secondaryCommandBuffers.resize(settings.framesInFlight);
+
+	for (uint32_t slot = 0; slot < settings.framesInFlight; slot++) {
+		secondaryCommandPools[slot].resize(threads);
+		secondaryCommandBuffers[slot].resize(threads);
+
+		for (uint32_t thread = 0; thread < threads; thread++) {
+			// Reset as a whole at the start of each frame, so no RESET_COMMAND_BUFFER flag
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			poolInfo.queueFamilyIndex = familyIndices.graphicsFamily.value();
+
+			if (vkCreateCommandPool(device, &poolInfo, nullptr, &secondaryCommandPools[slot][thread]) != VK_SUCCESS) {
+				throw std::runtime_error("No bathing in the secondary pool :(");
+			}
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = secondaryCommandPools[slot][thread];
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(device, &allocInfo, &secondaryCommandBuffers[slot][thread]) != VK_SUCCESS) {
+				throw std::runtime_error("Kunne ikke allokerer secondary command buffers!");
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Destroys the secondary command pools, which frees their command buffers too. The GPU must be done with them
+/// </summary>
+void SwagkantApp::destroySecondaryCommandBuffers() {
+	for (const auto& pools : secondaryCommandPools) {
+		for (auto pool : pools) {
+			vkDestroyCommandPool(device, pool, nullptr);
+		}
+	}
+
+	secondaryCommandPools.clear();
+	secondaryCommandBuffers.clear();
+}
+
+/// <summary>
+/// Restarts the recording threads with the given count and recreates their secondary command buffers, 0 records inline.
+/// The GPU must be idle
+/// </summary>
+void SwagkantApp::setRecordThreads(uint32_t threadCount) {
+	destroySecondaryCommandBuffers();
+	recordPool.init(threadCount);
+	if (threadCount > 0) {
+		createSecondaryCommandBuffers();
+	}
+}
+
+/// <summary>
+/// Creates an image-ready semaphore and a fence per frame in flight, and a render-done semaphore per swap chain image.
+/// The render-done semaphore belongs to the image since it is only free again once that image has been presented.
+/// On the timeline path the fences are replaced by a timeline semaphore per queue
+/// </summary>
+void SwagkantApp::createSyncObjects() {
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	VkFenceCreateInfo fenceInfo{};
+
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	if (timelineEnabled) {
+		graphicsTimeline = createTimelineSemaphore();
+		if (settings.computeInstances) {
+			computeTimeline = createTimelineSemaphore();
+		}
+	}
+	else {
+		flightFences.resize(settings.framesInFlight);
+		for (auto& fence : flightFences) {
+			if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+				throw std::runtime_error("Kunne ikke lave fence og semaphores!");
+			}
+		}
+	}
+
+	// Nothing is acquired or presented in headless mode
+	if (settings.headless) { return; }
+
+	imageReadySemaphores.resize(settings.framesInFlight);
+
+	for (auto& semaphore : imageReadySemaphores) {
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("Kunne ikke lave fence og semaphores!");
+		}
+	}
+
+	createRenderDoneSemaphores();
+}
+
+/// <summary>
+/// Creates a timeline semaphore starting at 0, no frame has completed yet
+/// </summary>
+VkSemaphore SwagkantApp::createTimelineSemaphore() {
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	VkSemaphore semaphore;
+	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+		throw std::runtime_error("Kunne ikke lave timeline semaphore!");
+	}
+	return semaphore;
+}
+
+/// <summary>
+/// Waits until the frame that last used the current slot has completed, on the slot's fence or the graphics timeline
+/// </summary>
+/// <returns>The number of frames known to have completed on the GPU</returns>
+uint64_t SwagkantApp::waitForFrameSlot() {
+	if (!timelineEnabled) {
+		vkWaitForFences(device, 1, &flightFences[currentFrame], VK_TRUE, UINT64_MAX);
+
+		// Waiting on the slot's fence means every frame up to the one that last used this slot has completed
+		return frameNumber + 1 >= settings.framesInFlight ? frameNumber + 1 - settings.framesInFlight : 0;
+	}
+
+	if (frameNumber >= settings.framesInFlight) {
+		uint64_t waitValue = frameNumber + 1 - settings.framesInFlight;
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &graphicsTimeline;
+		waitInfo.pValues = &waitValue;
+
+		if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+			throw std::runtime_error("Kunne ikke vente p timeline semaphore!");
+		}
+	}
+
+	// The counter may already be past the waited value, which retires resources sooner than the fence path can
+	uint64_t completedFrames = 0;
+	vkGetSemaphoreCounterValue(device, graphicsTimeline, &completedFrames);
+	return completedFrames;
+}
+
+/// <summary>
+/// Creates a render-done semaphore per swap chain image, again whenever the swap chain is recreated
+/// </summary>
+void SwagkantApp::createRenderDoneSemaphores() {
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	renderDoneSemaphores.resize(swapChainImages.size());
+	for (auto& semaphore : renderDoneSemaphores) {
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("Kunne ikke lave fence og semaphores!");
+		}
+	}
+}
+
+void SwagkantApp::recordCommandBuffer(VkCommandBuffer comBuffer, uint32_t imageIndex) {
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = 0;
+	beginInfo.pInheritanceInfo = nullptr;
+
+	if (vkBeginCommandBuffer(comBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Kunne ikke begynde at optage command buffers!");
+	}
+
+	gpuProfiler.beginFrame(comBuffer, currentFrame, frameNumber);
+	uploader.acquire(comBuffer, frameNumber, frameWaitSemaphores, frameWaitStages);
+
+	// The slot's previous frame has completed, so its region of the ring can be rewritten
+	FrameUniforms frameUniforms{};
+	frameUniforms.viewProjection = glm::scale(glm::mat4(1.0f), glm::vec3(settings.cameraZoom, settings.cameraZoom, 1.0f)); // The quads are laid out in clip space
+	uniformRing.beginFrame(currentFrame);
+	frameDataOffset = uniformRing.push(frameUniforms);
+
+	if (cpuCullingEnabled) {
+		cullInstances(frameUniforms.viewProjection);
+	}
+	// The streamer's barriers stay its own, which mip levels it copies is only known once it has spent the frame budget,
+	// and its images are only read through the texture array, which the graph doesn't track
+	if (texturesEnabled) {
+		textureStreamer.record(comBuffer, frameNumber);
+	}
+
+	frameGraph.reset();
+
+	RenderGraph::ResourceId image = frameGraph.importImage("swap chain image", swapChainImages[imageIndex],
+		{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, SWAPCHAIN_ACQUIRE_USAGE);
+	// Presenting is ordered by the render-done semaphore, so nothing later in this queue has to wait for the image
+	VkImageLayout finalLayout = settings.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	frameGraph.markOutput(image, { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, finalLayout });
+
+	RenderGraph::ResourceId indirect = 0;
+	RenderGraph::ResourceId visible = 0;
+	if (gpuCullingEnabled) {
+		indirect = frameGraph.importBuffer("indirect draws", indirectBuffers[currentFrame]);
+		visible = frameGraph.importBuffer("visible instances", visibleInstanceBuffers[currentFrame]);
+		addCullingPasses(indirect, visible);
+	}
+
+	RenderGraph::PassId draw = frameGraph.addPass("draw", [this, imageIndex](VkCommandBuffer comBuffer) {
+		recordDrawPass(comBuffer, imageIndex);
+	});
+	if (dynamicRenderingEnabled) {
+		frameGraph.write(draw, image, COLOR_ATTACHMENT_USAGE);
+	}
+	else {
+		frameGraph.attachment(draw, image, COLOR_ATTACHMENT_USAGE, finalLayout);
+	}
+	if (gpuCullingEnabled) {
+		frameGraph.read(draw, indirect, { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT });
+		frameGraph.read(draw, visible, { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT });
+	}
+
+	frameGraph.compile();
+	if (settings.printGraph && frameNumber == 0) {
+		frameGraph.print();
+	}
+	frameGraph.execute(comBuffer);
+
+	if (vkEndCommandBuffer(comBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Kunne ikke optage command buffer!");
+	}
+}
+
+/// <summary>
+/// Records the frame graph's draw pass, on the recording threads when there are any
+/// </summary>
+void SwagkantApp::recordDrawPass(VkCommandBuffer comBuffer, uint32_t imageIndex) {
+	bool threaded = recordPool.size() > 0;
+
+	gpuProfiler.beginRenderPass(comBuffer);
+
+	if (threaded) {
+		// A subpass with secondary contents may only execute commands, so the draw queries wrap the whole render pass instead
+		gpuProfiler.beginDraw(comBuffer);
+		beginRendering(comBuffer, imageIndex, true);
+
+		recordPool.parallelFor(recordPool.size(), [this, imageIndex](uint32_t thread) {
+			recordSecondaryCommandBuffer(thread, imageIndex);
+		});
+
+		const auto& secondaries = secondaryCommandBuffers[currentFrame];
+		vkCmdExecuteCommands(comBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+
+		endRendering(comBuffer, imageIndex);
+		gpuProfiler.endDraw(comBuffer);
+	}
+	else {
+		beginRendering(comBuffer, imageIndex, false);
+
+		gpuProfiler.beginDraw(comBuffer);
+		recordDraws(comBuffer, 0, activeDrawCount());
+		gpuProfiler.endDraw(comBuffer);
+
+		endRendering(comBuffer, imageIndex);
+	}
+
+	gpuProfiler.endRenderPass(comBuffer);
+}
+
+/// <summary>
+/// Starts rendering to the image, clearing it. With dynamic rendering the frame graph has already moved the image
+/// to the attachment layout, which the render pass otherwise does through its initial layout and subpass dependency
+/// </summary>
+/// <param name="secondaryContents">Whether the draws are recorded into secondary command buffers</param>
+void SwagkantApp::beginRendering(VkCommandBuffer comBuffer, uint32_t imageIndex, bool secondaryContents) {
+	VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
+
+	if (!dynamicRenderingEnabled) {
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = swapChainExtent;
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearColor;
+
+		vkCmdBeginRenderPass(comBuffer, &renderPassInfo, secondaryContents ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+		return;
+	}
+
+	VkRenderingAttachmentInfoKHR colorAttachment{};
+	colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+	colorAttachment.imageView = swapChainImageViews[imageIndex];
+	colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.clearValue = clearColor;
+
+	VkRenderingInfoKHR renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+	renderingInfo.flags = secondaryContents ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+	renderingInfo.renderArea.offset = { 0, 0 };
+	renderingInfo.renderArea.extent = swapChainExtent;
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachments = &colorAttachment;
+
+	cmdBeginRendering(comBuffer, &renderingInfo);
+}
+
+/// <summary>
+/// Ends rendering to the image. With dynamic rendering the frame graph's last barrier moves the image to the layout
+/// the render pass would have left it in, ready to be presented, or copied out in headless mode
+/// </summary>
+void SwagkantApp::endRendering(VkCommandBuffer comBuffer, uint32_t imageIndex) {
+	if (!dynamicRenderingEnabled) {
+		vkCmdEndRenderPass(comBuffer);
+		return;
+	}
+
+	cmdEndRendering(comBuffer);
+}
+
+/// <summary>
+/// Records this thread's share of the draws into its secondary command buffer of the current frame slot. Runs on a worker thread,
+/// so it only touches the command pool owned by that thread and slot
+/// </summary>
+void SwagkantApp::recordSecondaryCommandBuffer(uint32_t thread, uint32_t imageIndex) {
+	VkCommandBuffer comBuffer = secondaryCommandBuffers[currentFrame][thread];
+	vkResetCommandPool(device, secondaryCommandPools[currentFrame][thread], 0);
+
+	// With dynamic rendering the secondaries inherit the attachment formats instead of a render pass and framebuffer
+	VkCommandBufferInheritanceRenderingInfoKHR renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachmentFormats = &swapChainImageFormat;
+	renderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.pNext = dynamicRenderingEnabled ? &renderingInfo : nullptr;
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = dynamicRenderingEnabled ? VK_NULL_HANDLE : swapChainFramebuffers[imageIndex];
+	inheritanceInfo.pipelineStatistics = gpuProfiler.hasPipelineStatistics() ? GpuProfiler::PIPELINE_STATISTICS : 0;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	if (vkBeginCommandBuffer(comBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Kunne ikke begynde at optage secondary command buffer!");
+	}
+
+	// Contiguous draw ranges, the first threads get one extra draw when it doesn't divide evenly
+	uint32_t draws = activeDrawCount();
+	uint32_t threads = recordPool.size();
+	recordDraws(comBuffer, draws * thread / threads, draws * (thread + 1) / threads);
+
+	if (vkEndCommandBuffer(comBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Kunne ikke optage secondary command buffer!");
+	}
+}
+
+/// <summary>
+/// Binds the pipeline, dynamic state and buffers, then records the draws [firstDraw, endDraw).
+/// Each draw covers an equal share of the instances
+/// </summary>
+void SwagkantApp::recordDraws(VkCommandBuffer comBuffer, uint32_t firstDraw, uint32_t endDraw) {
+	if (firstDraw >= endDraw) { return; }
+
+	vkCmdBindPipeline(comBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines[static_cast<size_t>(settings.pipelineVariant)]);
+
+	// The frame's uniforms are picked by the dynamic offset, the sets themselves never change
+	VkDescriptorSet sets[] = { uniformRing.getSet(), textureManager.getSet(currentFrame) };
+	vkCmdBindDescriptorSets(comBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, texturesEnabled ? 2 : 1, sets, 1, &frameDataOffset);
+
+	// Nothing moves a whole draw yet, so every draw shares the identity constants and they are pushed once
+	DrawConstants drawConstants{};
+	vkCmdPushConstants(comBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &drawConstants);
+
+	VkViewport view{};
+	view.x = view.y = 0.0f;
+	view.width = static_cast<float>(swapChainExtent.width);
+	view.height = static_cast<float>(swapChainExtent.height);
+	view.minDepth = 0.0f;
+	view.maxDepth = 1.0f;
+	vkCmdSetViewport(comBuffer, 0, 1, &view);
+
+	VkRect2D scissor{};
+	scissor.offset = { 0, 0 };
+	scissor.extent = swapChainExtent;
+	vkCmdSetScissor(comBuffer, 0, 1, &scissor);
+
+	VkBuffer instances = settings.computeInstances ? animatedInstanceBuffers[currentFrame] : instanceBuffer;
+	if (sceneEnabled) {
+		instances = sceneInstanceBuffers[currentFrame];
+	}
+	if (gpuCullingEnabled) {
+		instances = visibleInstanceBuffers[currentFrame];
+	}
+	if (cpuCullingEnabled) {
+		instances = culledInstanceBuffers[currentFrame];
+	}
+	VkBuffer vertexBuffers[] = { vertexBuffer, instances };
+	VkDeviceSize offsets[] = { 0, 0 };
+	vkCmdBindVertexBuffers(comBuffer, 0, 2, vertexBuffers, offsets);
+	vkCmdBindIndexBuffer(comBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+
+	uint32_t draws = activeDrawCount();
+	uint32_t indexCount = static_cast<uint32_t>(quadIndices.size());
+	bool instanced = getPipelineVariant(settings.pipelineVariant).data.instanced == VK_TRUE;
+
+	// The culling pass wrote the draws, so whichever recording covers the first draw issues all of them at once
+	if (gpuCullingEnabled) {
+		if (firstDraw > 0) { return; }
+
+		uint32_t maxDraws = (drawInstanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE;
+		VkBuffer indirect = indirectBuffers[currentFrame];
+		if (cmdDrawIndexedIndirectCount != nullptr) {
+			cmdDrawIndexedIndirectCount(comBuffer, indirect, INDIRECT_DRAWS_OFFSET, indirect, 0, maxDraws, sizeof(VkDrawIndexedIndirectCommand));
+		}
+		else {
+			vkCmdDrawIndexedIndirect(comBuffer, indirect, INDIRECT_DRAWS_OFFSET, maxDraws, sizeof(VkDrawIndexedIndirectCommand));
+		}
+		return;
+	}
+
+	uint32_t drawnInstances = drawnInstanceCount();
+	for (uint32_t draw = firstDraw; draw < endDraw; draw++) {
+		uint32_t firstInstance = static_cast<uint32_t>(static_cast<uint64_t>(drawnInstances) * draw / draws);
+		uint32_t endInstance = static_cast<uint32_t>(static_cast<uint64_t>(drawnInstances) * (draw + 1) / draws);
+
+		// Without instancing every instance would land on the same spot, so one per draw is enough
+		uint32_t instanceCount = instanced ? endInstance - firstInstance : std::min(endInstance - firstInstance, 1u);
+		vkCmdDrawIndexed(comBuffer, indexCount, instanceCount, 0, 0, firstInstance);
+	}
+}
+
+/// <summary>
+/// Number of draw calls per frame, never more than there are instances
+/// </summary>
+uint32_t SwagkantApp::activeDrawCount() const {
+	return std::clamp(settings.drawCount, 1u, std::max(drawnInstanceCount(), 1u));
+}
+
+/// <summary>
+/// Number of instances the draws of the frame being recorded cover, only the visible ones with CPU culling
+/// </summary>
+uint32_t SwagkantApp::drawnInstanceCount() const {
+	return cpuCullingEnabled ? culledInstanceCount : drawInstanceCount;
+}
+
+/// <summary>
+/// Creates a buffer and sub-allocates and binds memory with the given properties for it
+/// </summary>
+/// <param name="queueFamilies">Families the buffer is shared between without ownership transfers, exclusive with fewer than two</param>
+void SwagkantApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, GpuAllocation& bufferMemory,
+	AllocationStrategy strategy, const std::vector<uint32_t>& queueFamilies) {
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (queueFamilies.size() > 1) {
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+		bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+	}
+
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create buffer!");
+	}
+
+	bufferMemory = allocator.allocateBuffer(buffer, properties, strategy);
+}
+
+/// <summary>
+/// Creates a DEVICE_LOCAL buffer and queues the upload of data into it on the transfer queue.
+/// The next frame acquires it, so it can be used right away without waiting for the copy on the CPU
+/// </summary>
+/// <param name="usage">How the buffer is used, TRANSFER_DST is added automatically</param>
+void SwagkantApp::uploadToDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, GpuAllocation& bufferMemory) {
+	createBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+
+	// Where the graphics queue first reads the buffer
+	VkPipelineStageFlags dstStage = 0;
+	VkAccessFlags dstAccess = 0;
+	if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) {
+		dstStage |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		dstAccess |= VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	}
+	if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) {
+		dstStage |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		dstAccess |= VK_ACCESS_INDEX_READ_BIT;
+	}
+	if (usage & (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)) {
+		dstStage |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dstAccess |= VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+	}
+	if (dstStage == 0) {
+		dstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		dstAccess = VK_ACCESS_MEMORY_READ_BIT;
+	}
+
+	uploader.uploadBuffer(buffer, 0, data, size, dstStage, dstAccess);
 }
\ No newline at end of file
@@ -6,30 +6,100 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <glm/gtc/matrix_transform.hpp>
+
 #include <stdexcept>
 #include <iostream>
 #include <optional>
 #include <cstdlib>
 #include <vector>
+#include <span>
+#include <string>
 #include <map>
 #include <set>
 
 #include <cstdint>
+#include <cstring>
+#include <chrono>
 #include <limits>
 #include <algorithm>
+#include <random>
+#include <cmath>
 
 #include "SwagDebug.hpp"
 #include "IO.hpp"
+#include "FrameStats.hpp"
+#include "GpuProfiler.hpp"
+#include "GpuAllocator.hpp"
+#include "ThreadPool.hpp"
+#include "DeletionQueue.hpp"
+#include "AsyncUploader.hpp"
+#include "DeviceSelector.hpp"
+#include "TaskGraph.hpp"
+#include "PipelineCache.hpp"
+#include "ShaderRegistry.hpp"
+#include "Vertex.hpp"
+#include "PipelineVariants.hpp"
+#include "TextureManager.hpp"
+#include "TextureStreamer.hpp"
+#include "UniformRing.hpp"
+#include "FrustumCuller.hpp"
+#include "Scene.hpp"
+#include "RenderGraph.hpp"
 
 const uint16_t WIDTH = 800;
 const uint16_t HEIGHT = 600;
 
+// Depth of the frame ring, 1 keeps the CPU and GPU in lockstep (useful as a baseline)
+const uint32_t MIN_FRAMES_IN_FLIGHT = 1;
+const uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+// Instance count reached by the instance benchmark, which sweeps up to it in steps of 10x
+const uint32_t MAX_INSTANCES = 1000000;
+const uint32_t INSTANCE_BENCH_FRAMES = 200;
+
+// The culling pass compacts every group of CULL_GROUP_SIZE instances into one indirect draw, see cull.comp
+const uint32_t CULL_GROUP_SIZE = 64;
+const VkDeviceSize INDIRECT_DRAWS_OFFSET = 16;
+
+// The CPU culling benchmark tests CULL_BENCH_OBJECTS random spheres CULL_BENCH_PASSES times with every kernel
+const uint32_t CULL_BENCH_OBJECTS = 1000000;
+const uint32_t CULL_BENCH_PASSES = 100;
+
+// The scene parents every SCENE_CLUSTER_SIZE x SCENE_CLUSTER_SIZE block of the grid to its first cell,
+// and every SCENE_SPIN_STRIDE-th cluster spins by SCENE_SPIN_SPEED radians per frame
+const uint32_t SCENE_CLUSTER_SIZE = 4;
+const uint32_t SCENE_SPIN_STRIDE = 4;
+const float SCENE_SPIN_SPEED = 0.01f;
+
+// The swap chain image as the acquire semaphore hands it over, and as the draws use it.
+// The render pass' external dependency and the frame graph's barriers are both made from these
+const ResourceUsage SWAPCHAIN_ACQUIRE_USAGE = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED };
+const ResourceUsage COLOR_ATTACHMENT_USAGE = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+// Draw calls per frame used by the recording benchmark unless --draws is given
+const uint32_t RECORD_BENCH_DRAWS = 20000;
+
+// The resize stress test switches between two window sizes every RESIZE_BENCH_INTERVAL frames
+const uint32_t RESIZE_BENCH_FRAMES = 1000;
+const uint32_t RESIZE_BENCH_INTERVAL = 10;
+
+// Color format of the images rendered to in headless mode
+const VkFormat OFFSCREEN_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
 const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
 };
 const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
+const std::vector<const char*> headlessDeviceExtensions = {};
+// Used when present, a device supporting them is ranked higher
+const std::vector<const char*> optionalDeviceExtensions = {
+	VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+	VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+	VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME
+};
 
 #ifndef NDEBUG
 const bool enableValidationLayers = true;
@@ -40,9 +110,12 @@ const bool enableValidationLayers = false;
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	std::optional<uint32_t> transferFamily; // Dedicated transfer family if there is one, otherwise the graphics family
+	std::optional<uint32_t> computeFamily; // Compute family without graphics if there is one, otherwise the graphics family
 
-	bool isComplete() const {
-		return graphicsFamily.has_value() && presentFamily.has_value();
+	/// <param name="headless">Whether a present family is not needed, since nothing gets presented</param>
+	bool isComplete(bool headless = false) const {
+		return graphicsFamily.has_value() && (headless || presentFamily.has_value());
 	}
 };
 
@@ -56,38 +129,211 @@ struct SwapChainSupportDetails {
 	}
 };
 
+/// <summary>
+/// Runtime options, filled from the command line in main.cpp
+/// </summary>
+struct AppSettings {
+	uint32_t framesInFlight = 2;
+	double benchmarkSeconds = 0.0; // Stops the main loop after this many seconds, 0 runs until the window is closed
+
+	// Renders into device-owned images without GLFW, a surface or a swap chain
+	bool headless = false;
+	uint32_t headlessFrames = 1000;
+
+	std::string gpuStatsPath; // Dumps the per frame GPU timings to this file (.csv or .json) when set
+
+	bool usePipelineCache = true;
+	std::string pipelineCachePath = "pipeline_cache.bin";
+
+	bool benchAllocator = false; // Runs the GPU memory allocator microbenchmark instead of the main loop
+
+	uint32_t instanceCount = 1; // Quads drawn per frame, laid out in a grid covering the screen
+	bool benchInstances = false; // Sweeps the instance count from 1 to MAX_INSTANCES instead of running the main loop
+
+	uint32_t drawCount = 1; // The instances are split into this many draw calls
+	uint32_t recordThreads = 0; // Worker threads recording secondary command buffers, 0 records everything inline on the main thread
+	bool benchRecord = false; // Sweeps the number of recording threads instead of running the main loop
+
+	bool benchResize = false; // Resizes the window back and forth while rendering and reports the frame time spikes
+
+	bool computeInstances = false; // Animates the instances in a compute shader every frame instead of drawing the static grid
+
+	bool timelineSemaphores = false; // Tracks the GPU work with a timeline semaphore per queue instead of a fence per frame slot (Vulkan 1.2)
+
+	bool dynamicRendering = false; // Renders with VK_KHR_dynamic_rendering instead of a render pass and framebuffers
+
+	std::string deviceUuid; // Pins the GPU by its deviceUUID instead of ranking them, defaults to SWAGKANT_DEVICE_UUID
+	bool probeDevices = false; // Runs a short copy benchmark on every suitable GPU and adds the bandwidth to its score
+
+	PipelineVariant pipelineVariant = PipelineVariant::Default; // Which of the specialized graphics pipelines draws the quads
+
+	bool bindlessTextures = false; // Textures the quads from one descriptor-indexed array, each instance picks its texture by index (Vulkan 1.2)
+	std::vector<std::string> texturePaths; // KTX2 files streamed in instead of the procedural textures, implies bindlessTextures
+	uint32_t streamBudgetKb = 2048; // Texture data copied per frame at most
+
+	bool gpuCulling = false; // Culls the instances in a compute pass that also writes the draws, drawn with indirect draws
+	float cameraZoom = 1.0f; // Above 1 part of the grid ends up outside the view
+
+	bool cpuCulling = false; // Culls the instances on the CPU every frame and draws only the visible ones
+	bool benchCulling = false; // Runs the CPU culling microbenchmark instead of the main loop, without a window or device
+
+	bool scene = false; // Animates the instances as a transform hierarchy on the CPU instead of drawing the static grid
+
+	bool printGraph = false; // Prints the first frame's render graph: the pass order, the culled passes and the barriers
+};
+
 /// <summary>
 /// Les main app B)
 /// </summary>
 class SwagkantApp {
 public:
-	void run(const char* title);
+	void run(const char* title, const AppSettings& appSettings = AppSettings{});
+
+	const GpuProfiler& getGpuProfiler() const { return gpuProfiler; }
 
 private:
+	AppSettings settings;
+	std::string windowTitle;
+
 	GLFWwindow* window = nullptr;
 	VkInstance instance = nullptr;
-	VkSurfaceKHR surface;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
 
-	VkSwapchainKHR swapChain;
-	std::vector<VkImage> swapChainImages;
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+	std::vector<VkImage> swapChainImages; // Holds the offscreen images in headless mode
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
 	std::vector<VkImageView> swapChainImageViews;
 	std::vector<VkFramebuffer> swapChainFramebuffers;
 
+	std::vector<VkImage> offscreenImages;
+	std::vector<GpuAllocation> offscreenImageMemory;
+
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 	VkDevice device;
 	VkQueue graphicsQueue;
-	VkQueue presentQueue;
-	VkRenderPass renderPass;
+	VkQueue presentQueue = VK_NULL_HANDLE;
+	VkQueue transferQueue = VK_NULL_HANDLE;
+	VkQueue computeQueue = VK_NULL_HANDLE;
+	VkRenderPass renderPass = VK_NULL_HANDLE; // Stays null with dynamic rendering
 	VkPipelineLayout pipelineLayout;
-	VkPipeline graphicsPipeline;
+	std::array<VkPipeline, PIPELINE_VARIANTS.size()> graphicsPipelines{}; // Indexed by PipelineVariant
+	PipelineCache pipelineCache;
+	GpuAllocator allocator;
+	AsyncUploader uploader;
 	VkCommandPool commandPool;
-	VkCommandBuffer commandBuffer;
 
-	VkSemaphore imageReadySemaphore;
-	VkSemaphore renderDoneSemaphore;
-	VkFence flightFence;
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+	GpuAllocation vertexBufferMemory;
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	GpuAllocation indexBufferMemory;
+	VkBuffer instanceBuffer = VK_NULL_HANDLE;
+	GpuAllocation instanceBufferMemory;
+	uint32_t drawInstanceCount = 0;
+
+	// Compute animated instances, written by instances.comp into the frame slot's buffer and drawn by the same frame
+	VkDescriptorSetLayout computeSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout computePipelineLayout = VK_NULL_HANDLE;
+	VkPipeline computePipeline = VK_NULL_HANDLE;
+	VkDescriptorPool computeDescriptorPool = VK_NULL_HANDLE;
+	VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> computeDescriptorSets; // Per frame slot
+	std::vector<VkCommandBuffer> computeCommandBuffers; // Per frame slot
+	std::vector<VkSemaphore> computeDoneSemaphores; // Per frame slot
+	std::vector<VkBuffer> animatedInstanceBuffers; // Per frame slot
+	std::vector<GpuAllocation> animatedInstanceMemory;
+
+	// Semaphores the frame's submit waits on, the image-ready semaphore and the uploads acquired while recording
+	std::vector<VkSemaphore> frameWaitSemaphores;
+	std::vector<VkPipelineStageFlags> frameWaitStages;
+
+	// Per frame slot, indexed by currentFrame
+	std::vector<VkCommandBuffer> commandBuffers;
+	std::vector<VkSemaphore> imageReadySemaphores;
+	std::vector<VkFence> flightFences; // Empty on the timeline path
+	uint32_t currentFrame = 0;
+
+	// Timeline path, a semaphore per queue counting the frames whose work on it has completed, so frame N signals N + 1
+	bool timelineEnabled = false;
+	uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+	VkSemaphore graphicsTimeline = VK_NULL_HANDLE;
+	VkSemaphore computeTimeline = VK_NULL_HANDLE;
+
+	// Dynamic rendering path, there is no render pass or framebuffers and the layouts are changed with barriers
+	bool dynamicRenderingEnabled = false;
+	PFN_vkCmdBeginRenderingKHR cmdBeginRendering = nullptr;
+	PFN_vkCmdEndRenderingKHR cmdEndRendering = nullptr;
+
+	// Per-frame uniforms, written to the ring by recordCommandBuffer and bound as set 0 at frameDataOffset by every command buffer
+	UniformRing uniformRing;
+	uint32_t frameDataOffset = 0;
+
+	// The passes of the frame being recorded, rebuilt by recordCommandBuffer every frame
+	RenderGraph frameGraph;
+
+	// GPU culling path, per frame slot the culling pass compacts the visible instances and writes the indirect draws.
+	// With VK_KHR_draw_indirect_count only the non-empty draws are written and the GPU reads how many there are
+	bool gpuCullingEnabled = false;
+	PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr; // Null without the extension
+	VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline cullPipeline = VK_NULL_HANDLE;
+	VkDescriptorPool cullDescriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> cullDescriptorSets; // Per frame slot
+	std::vector<VkBuffer> visibleInstanceBuffers; // Per frame slot
+	std::vector<GpuAllocation> visibleInstanceMemory;
+	std::vector<VkBuffer> indirectBuffers; // Per frame slot, the draw count followed by the draws at INDIRECT_DRAWS_OFFSET
+	std::vector<GpuAllocation> indirectMemory;
+
+	// CPU culling path, per frame recordCommandBuffer culls the instances' bounding spheres and copies the visible
+	// instances into the frame slot's host visible buffer, which is drawn instead of the instance buffer
+	bool cpuCullingEnabled = false;
+	FrustumCuller frustumCuller;
+	std::vector<InstanceData> cpuInstances; // The instance buffer's contents, indexed like the culler's spheres
+	std::vector<VkBuffer> culledInstanceBuffers; // Per frame slot
+	std::vector<GpuAllocation> culledInstanceMemory;
+	uint32_t culledInstanceCount = 0; // Visible instances of the frame being recorded
+
+	// Scene path, every frame drawFrame updates the transform hierarchy and writes the moved nodes into the frame slot's
+	// host visible buffer, which is drawn instead of the instance buffer. Node i is instance i
+	bool sceneEnabled = false;
+	Scene scene;
+	std::vector<uint32_t> spinningNodes; // The parents rotated every frame
+	std::vector<VkBuffer> sceneInstanceBuffers; // Per frame slot
+	std::vector<GpuAllocation> sceneInstanceMemory;
+	std::vector<uint64_t> sceneSlotVersions; // Per frame slot, the scene version its buffer holds
+	uint32_t sceneRecomputedNodes = 0; // By the last update
+	FrameStats sceneStats; // CPU time spent updating the scene and writing the instances per frame
+
+	// Bindless path, every texture sits in one descriptor array bound once per command buffer as set 1
+	bool texturesEnabled = false;
+	TextureManager textureManager;
+	TextureStreamer textureStreamer;
+
+	// Per frame slot and recording thread, [currentFrame][thread]
+	std::vector<std::vector<VkCommandPool>> secondaryCommandPools;
+	std::vector<std::vector<VkCommandBuffer>> secondaryCommandBuffers;
+	ThreadPool recordPool;
+
+	// Per swap chain image, indexed by the acquired image index
+	std::vector<VkSemaphore> renderDoneSemaphores;
+
+	// Swap chain resources replaced by a resize, destroyed once the frames using them have completed
+	DeletionQueue deletionQueue;
+	bool framebufferResized = false;
+	bool swapchainRecreated = false; // Set by recreateSwapchain, lets benchmarks tell which frames recreated it
+	FrameStats recreateStats; // CPU time spent in recreateSwapchain
+
+	uint64_t frameNumber = 0;
+	std::chrono::steady_clock::time_point startTime;
+	double pipelineCreationMs = 0.0;
+	double deviceSetupMs = 0.0; // From the start until the logical device and pipeline cache exist
+	TaskGraph initTasks; // The rest of initVulkan, kept for its timings
+
+	FrameStats frameStats;
+	FrameStats recordStats; // CPU time spent in recordCommandBuffer per frame
+	GpuProfiler gpuProfiler;
+	bool pipelineStatisticsEnabled = false;
 
 	VkDebugUtilsMessengerEXT debugMessenger;
 
@@ -95,6 +341,11 @@ private:
 	void initVulkan();
 	void mainLoop();
 	void drawFrame();
+	void benchmarkAllocator();
+	void benchmarkInstances();
+	void benchmarkRecording();
+	void benchmarkResize();
+	void benchmarkCulling();
 	void cleanup();
 
 	void createInstance();
@@ -102,30 +353,74 @@ private:
 	bool checkValidationLayerSupport();
 
 	void pickPhysicalDevice();
-	uint32_t ratePhysicalDevice(VkPhysicalDevice device);
-	bool isDeviceSuitable(VkPhysicalDevice device);
+	std::string checkDeviceRequirements(VkPhysicalDevice device);
 	QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+	const std::vector<const char*>& getDeviceExtensions() const;
+	bool hasDeviceExtension(VkPhysicalDevice device, const char* name);
 
 	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilites);
 
-	VkShaderModule createShaderModule(const std::vector<char>& code);
+	VkShaderModule createShaderModule(std::span<const uint32_t> code);
 
 	void createLogicalDevice();
 	void createSurface();
-	void createSwapchain();
+	void createSwapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
+	void recreateSwapchain();
+	void createRenderDoneSemaphores();
+	static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
+	void createOffscreenImages();
 	void createImageViews();
 	void createRenderPass();
 	void createGraphicsPipeline();
+	void createComputePipeline();
+	void createTextures();
+	void createCullPipeline();
+	void createCullBuffers();
+	void destroyCullBuffers();
+	void addCullingPasses(RenderGraph::ResourceId indirect, RenderGraph::ResourceId visible);
+	void destroyCulling();
+	void createCulledInstanceBuffers();
+	void destroyCulledInstanceBuffers();
+	void cullInstances(const glm::mat4& viewProjection);
+	void buildScene(const std::vector<InstanceData>& instances, uint32_t side);
+	void createSceneInstanceBuffers(const std::vector<InstanceData>& instances);
+	void destroySceneInstanceBuffers();
+	void updateScene();
+	void createComputeCommandBuffers();
+	void createAnimatedInstanceBuffers();
+	void destroyAnimatedInstanceBuffers();
+	void submitCompute(std::vector<VkSemaphore>& waitSemaphores, std::vector<VkPipelineStageFlags>& waitStages);
+	void destroyCompute();
 	void createFramebuffers();
 	void createCommandPool();
-	void createCommandBuffer();
+	void createVertexBuffer();
+	void createIndexBuffer();
+	void createInstanceBuffer(uint32_t count);
+	void destroyInstanceBuffer();
+	void createCommandBuffers();
+	void createSecondaryCommandBuffers();
+	void destroySecondaryCommandBuffers();
+	void setRecordThreads(uint32_t threadCount);
 	void createSyncObjects();
+	VkSemaphore createTimelineSemaphore();
+	uint64_t waitForFrameSlot();
 
 	void recordCommandBuffer(VkCommandBuffer comBuffer, uint32_t imageIndex);
+	void beginRendering(VkCommandBuffer comBuffer, uint32_t imageIndex, bool secondaryContents);
+	void endRendering(VkCommandBuffer comBuffer, uint32_t imageIndex);
+	void recordDrawPass(VkCommandBuffer comBuffer, uint32_t imageIndex);
+	void recordSecondaryCommandBuffer(uint32_t thread, uint32_t imageIndex);
+	void recordDraws(VkCommandBuffer comBuffer, uint32_t firstDraw, uint32_t endDraw);
+	uint32_t activeDrawCount() const;
+	uint32_t drawnInstanceCount() const;
+
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, GpuAllocation& bufferMemory,
+		AllocationStrategy strategy = AllocationStrategy::Buddy, const std::vector<uint32_t>& queueFamilies = {});
+	void uploadToDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, GpuAllocation& bufferMemory);
 };
 
 #endif // !SWAGKANT_H
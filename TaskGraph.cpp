@@ -0,0 +1,151 @@
+#include "TaskGraph.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+/// <summary>
+/// Adds a task, it can only depend on tasks added before it so the graph can't have cycles
+/// </summary>
+/// <param name="mainThread">Whether the task has to run on the thread calling run()</param>
+TaskGraph::TaskId TaskGraph::add(const std::string& name, std::function<void()> task, const std::vector<TaskId>& dependencies, bool mainThread) {
+	TaskId id = static_cast<TaskId>(tasks.size());
+
+	Task newTask;
+	newTask.name = name;
+	newTask.run = std::move(task);
+	newTask.mainThread = mainThread;
+	newTask.pendingDependencies = static_cast<uint32_t>(dependencies.size());
+
+	for (TaskId dependency : dependencies) {
+		if (dependency >= id) {
+			throw std::runtime_error("Task " + name + " depends on a task that doesn't exist yet");
+		}
+		tasks[dependency].dependents.push_back(id);
+	}
+
+	tasks.push_back(std::move(newTask));
+	return id;
+}
+
+/// <summary>
+/// Runs every task and returns once all of them have finished. Without workers in the pool everything runs on the calling thread.
+/// The first exception thrown by a task is rethrown here, after the tasks already running have finished
+/// </summary>
+void TaskGraph::run(ThreadPool& pool) {
+	startTime = std::chrono::steady_clock::now();
+	finished = 0;
+	failed = false;
+	mainReady.clear();
+
+	bool runInline = pool.size() == 0;
+	for (TaskId id = 0; id < tasks.size(); id++) {
+		if (tasks[id].pendingDependencies == 0) {
+			dispatch(id, pool, runInline);
+		}
+	}
+
+	try {
+		while (true) {
+			TaskId next;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				taskDone.wait(lock, [this] { return !mainReady.empty() || finished == tasks.size() || failed; });
+				if (failed || mainReady.empty()) { break; }
+
+				next = mainReady.front();
+				mainReady.pop_front();
+			}
+
+			execute(next, pool, runInline);
+		}
+	}
+	catch (...) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			failed = true;
+		}
+
+		// The workers may still be running tasks of this graph, their own errors are dropped in favor of this one
+		try { pool.wait(); }
+		catch (...) {}
+		throw;
+	}
+
+	pool.wait();
+	elapsedMs = now();
+}
+
+/// <summary>
+/// Prints when each task started and how long it took, relative to the start of run()
+/// </summary>
+void TaskGraph::printTimings() const {
+	std::cout << std::fixed << std::setprecision(2);
+	for (const auto& task : tasks) {
+		std::cout << "  " << std::left << std::setw(28) << task.name << std::right
+			<< std::setw(9) << task.startMs << " -> " << std::setw(9) << task.endMs << " ms"
+			<< (task.mainThread ? "" : " (worker)") << "\n";
+	}
+	std::cout << std::defaultfloat;
+}
+
+double TaskGraph::totalMs() const {
+	return elapsedMs;
+}
+
+void TaskGraph::dispatch(TaskId id, ThreadPool& pool, bool runInline) {
+	if (tasks[id].mainThread || runInline) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			mainReady.push_back(id);
+		}
+		taskDone.notify_all();
+		return;
+	}
+
+	pool.submit([this, id, &pool, runInline] {
+		try {
+			execute(id, pool, runInline);
+		}
+		catch (...) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				failed = true;
+			}
+			taskDone.notify_all();
+			throw;
+		}
+	});
+}
+
+/// <summary>
+/// Runs the task, then dispatches the dependents it was the last dependency of
+/// </summary>
+void TaskGraph::execute(TaskId id, ThreadPool& pool, bool runInline) {
+	Task& task = tasks[id];
+	task.startMs = now();
+	task.run();
+	task.endMs = now();
+
+	std::vector<TaskId> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		finished++;
+		if (!failed) {
+			for (TaskId dependent : task.dependents) {
+				if (--tasks[dependent].pendingDependencies == 0) {
+					ready.push_back(dependent);
+				}
+			}
+		}
+	}
+
+	for (TaskId dependent : ready) {
+		dispatch(dependent, pool, runInline);
+	}
+	taskDone.notify_all();
+}
+
+double TaskGraph::now() const {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
@@ -0,0 +1,55 @@
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include "ThreadPool.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// A small dependency graph of tasks, each one starts as soon as the tasks it depends on have finished.
+/// Tasks that must stay on the calling thread (e.g. anything touching GLFW or the upload queue) run there,
+/// the rest run on the thread pool. Every task is timed, so the critical path can be read from the printed timeline
+/// </summary>
+class TaskGraph {
+public:
+	using TaskId = uint32_t;
+
+	TaskId add(const std::string& name, std::function<void()> task, const std::vector<TaskId>& dependencies = {}, bool mainThread = true);
+	void run(ThreadPool& pool);
+
+	void printTimings() const;
+	double totalMs() const;
+
+private:
+	struct Task {
+		std::string name;
+		std::function<void()> run;
+		std::vector<TaskId> dependents;
+		uint32_t pendingDependencies = 0;
+		bool mainThread = true;
+
+		double startMs = 0.0;
+		double endMs = 0.0;
+	};
+
+	std::vector<Task> tasks;
+	std::chrono::steady_clock::time_point startTime;
+	double elapsedMs = 0.0;
+
+	std::mutex mutex;
+	std::condition_variable taskDone;
+	std::deque<TaskId> mainReady; // Ready tasks waiting for the calling thread
+	uint32_t finished = 0;
+	bool failed = false;
+
+	void dispatch(TaskId id, ThreadPool& pool, bool runInline);
+	void execute(TaskId id, ThreadPool& pool, bool runInline);
+	double now() const;
+};
+
+#endif // !TASKGRAPH_H
@@ -0,0 +1,279 @@
+#include "TextureManager.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+/// <summary>
+/// Creates the sampler and a copy of the bindless descriptor set per frame slot, sized to MAX_TEXTURES or the device's update-after-bind limits
+/// </summary>
+void TextureManager::init(VkDevice device, VkPhysicalDevice physicalDevice, GpuAllocator* allocator, AsyncUploader* uploader, uint32_t frameSlots) {
+	this->device = device;
+	this->allocator = allocator;
+	this->uploader = uploader;
+
+	VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 properties2{};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &indexingProperties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+	// A combined image sampler counts as both a sampled image and a sampler, and as a resource of the fragment stage
+	capacity = std::min({ MAX_TEXTURES, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages, indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+		indexingProperties.maxDescriptorSetUpdateAfterBindSamplers, indexingProperties.maxPerStageUpdateAfterBindResources,
+		indexingProperties.maxUpdateAfterBindDescriptorsInAllPools / frameSlots });
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create texture sampler!");
+	}
+
+	VkDescriptorSetLayoutBinding binding{};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	binding.descriptorCount = capacity;
+	binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	// Slots that were never written may stay empty. Update after bind only allows writes between binding the set and submitting,
+	// writing the slot of a new texture while frames using the set are pending also needs unused-while-pending,
+	// and even that never covers a slot a pending frame samples
+	VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+		VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.bindingCount = 1;
+	bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create texture descriptor set layout!");
+	}
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSize.descriptorCount = capacity * frameSlots;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolInfo.maxSets = frameSlots;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create texture descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(frameSlots, setLayout);
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = pool;
+	allocInfo.descriptorSetCount = frameSlots;
+	allocInfo.pSetLayouts = layouts.data();
+
+	sets.resize(frameSlots);
+	if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate the texture descriptor sets!");
+	}
+	pendingWrites.assign(frameSlots, {});
+
+	// Shown by streamed textures until their smallest mip level has arrived
+	const uint32_t white = 0xFFFFFFFF;
+	placeholder = createImage(VK_FORMAT_R8G8B8A8_UNORM, 1, 1, 1);
+	upload(placeholder, 1, 1, &white);
+	placeholder.view = createView(placeholder, 0);
+}
+
+/// <summary>
+/// Destroys every texture, the sampler and the descriptor sets. The device must be idle
+/// </summary>
+void TextureManager::destroy() {
+	if (device == VK_NULL_HANDLE) { return; }
+
+	for (auto& texture : textures) {
+		destroyTexture(texture);
+	}
+	textures.clear();
+	destroyTexture(placeholder);
+
+	vkDestroyDescriptorPool(device, pool, nullptr);
+	sets.clear();
+	pendingWrites.clear();
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	vkDestroySampler(device, sampler, nullptr);
+	device = VK_NULL_HANDLE;
+}
+
+/// <summary>
+/// Creates an RGBA8 texture and queues its upload
+/// </summary>
+/// <param name="rgba">width * height pixels of 4 bytes, row by row</param>
+/// <returns>The index of the texture in the descriptor array</returns>
+uint32_t TextureManager::createTexture(uint32_t width, uint32_t height, const void* rgba) {
+	Texture texture = createImage(VK_FORMAT_R8G8B8A8_UNORM, width, height, 1);
+	upload(texture, width, height, rgba);
+	texture.view = createView(texture, 0);
+
+	return addTexture(texture);
+}
+
+/// <summary>
+/// Creates the image of a streamed texture without any contents, its slot points at the placeholder until setBaseMipLevel
+/// </summary>
+/// <returns>The index of the texture in the descriptor array</returns>
+uint32_t TextureManager::createStreamedTexture(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) {
+	return addTexture(createImage(format, width, height, mipLevels));
+}
+
+/// <summary>
+/// Switches the texture to a new view covering the levels from baseMipLevel down to the smallest,
+/// which must all be in SHADER_READ_ONLY_OPTIMAL by the time the next submitted frame samples them.
+/// Each frame slot's copy of the array picks the view up in its next beginFrame
+/// </summary>
+/// <returns>The previous view, which frames already submitted may still use, or null when that was the placeholder</returns>
+VkImageView TextureManager::setBaseMipLevel(uint32_t index, uint32_t baseMipLevel) {
+	Texture& texture = textures[index];
+	VkImageView previous = texture.view;
+
+	texture.view = createView(texture, baseMipLevel);
+	queueWrite(index);
+
+	return previous;
+}
+
+/// <summary>
+/// Writes the slots that changed since the frame slot's last frame into its copy of the array.
+/// Called once the slot's previous frame has completed, so no pending command buffer uses the copy being written
+/// </summary>
+void TextureManager::beginFrame(uint32_t frameSlot) {
+	std::vector<uint32_t>& indices = pendingWrites[frameSlot];
+	if (indices.empty()) { return; }
+
+	std::vector<VkDescriptorImageInfo> imageInfos(indices.size());
+	std::vector<VkWriteDescriptorSet> writes(indices.size());
+	for (size_t i = 0; i < indices.size(); i++) {
+		VkImageView view = textures[indices[i]].view;
+		imageInfos[i].sampler = sampler;
+		imageInfos[i].imageView = view != VK_NULL_HANDLE ? view : placeholder.view;
+		imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = sets[frameSlot];
+		writes[i].dstBinding = 0;
+		writes[i].dstArrayElement = indices[i];
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[i].pImageInfo = &imageInfos[i];
+	}
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	indices.clear();
+}
+
+TextureManager::Texture TextureManager::createImage(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) {
+	Texture texture;
+	texture.format = format;
+	texture.mipLevels = mipLevels;
+
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = format;
+	imageInfo.extent = { width, height, 1 };
+	imageInfo.mipLevels = mipLevels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	if (vkCreateImage(device, &imageInfo, nullptr, &texture.image) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create texture image!");
+	}
+	texture.memory = allocator->allocateImage(texture.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	return texture;
+}
+
+/// <summary>
+/// Queues the upload of the single level of an RGBA8 texture
+/// </summary>
+void TextureManager::upload(const Texture& texture, uint32_t width, uint32_t height, const void* rgba) {
+	VkBufferImageCopy region{};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = { width, height, 1 };
+
+	uploader->uploadImage(texture.image, rgba, static_cast<VkDeviceSize>(width) * height * 4, { region }, 1,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+VkImageView TextureManager::createView(const Texture& texture, uint32_t baseMipLevel) {
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = texture.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = texture.format;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseMipLevel, texture.mipLevels - baseMipLevel, 0, 1 };
+
+	VkImageView view;
+	if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create texture image view!");
+	}
+
+	return view;
+}
+
+void TextureManager::destroyTexture(Texture& texture) {
+	vkDestroyImageView(device, texture.view, nullptr);
+	vkDestroyImage(device, texture.image, nullptr);
+	allocator->free(texture.memory);
+	texture = Texture{};
+}
+
+/// <summary>
+/// Queues the slot for every frame slot's copy of the array, it then points at the texture's view or at the placeholder while that is null
+/// </summary>
+void TextureManager::queueWrite(uint32_t index) {
+	for (auto& indices : pendingWrites) {
+		indices.push_back(index);
+	}
+}
+
+/// <summary>
+/// Takes ownership of the texture and queues it into the next free slot of the descriptor array
+/// </summary>
+uint32_t TextureManager::addTexture(Texture texture) {
+	if (textures.size() >= capacity) {
+		destroyTexture(texture);
+		throw std::runtime_error("The texture descriptor array is full!");
+	}
+
+	uint32_t index = static_cast<uint32_t>(textures.size());
+	textures.push_back(texture);
+	queueWrite(index);
+
+	return index;
+}
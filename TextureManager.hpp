@@ -0,0 +1,72 @@
+#ifndef TEXTUREMANAGER_H
+#define TEXTUREMANAGER_H
+
+#include <vulkan/vulkan.h>
+
+#include "AsyncUploader.hpp"
+#include "GpuAllocator.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Owns every texture and a descriptor set holding all of them in one array (binding 0), shaders pick a texture by index.
+/// The array is partially bound, so draws with different textures never need another descriptor set.
+/// Every frame slot has its own copy of the set. Changes are queued and only written into a copy by beginFrame,
+/// once the frame that last used it has completed, so a slot a pending frame samples is never rewritten,
+/// not even when a streamed texture switches to a sharper view.
+/// Needs the descriptor indexing features, enabled by createLogicalDevice
+/// </summary>
+class TextureManager {
+public:
+	static constexpr uint32_t MAX_TEXTURES = 4096;
+
+	void init(VkDevice device, VkPhysicalDevice physicalDevice, GpuAllocator* allocator, AsyncUploader* uploader, uint32_t frameSlots);
+	void destroy();
+
+	// Uploads the pixels through the uploader, so the texture is ready for the first frame that acquires the batch
+	uint32_t createTexture(uint32_t width, uint32_t height, const void* rgba);
+
+	// A texture whose mip levels are filled in later (see TextureStreamer), until then its slot shows a 1x1 white placeholder
+	uint32_t createStreamedTexture(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels);
+	VkImageView setBaseMipLevel(uint32_t index, uint32_t baseMipLevel);
+	VkImage getImage(uint32_t index) const { return textures[index].image; }
+
+	void beginFrame(uint32_t frameSlot);
+
+	VkDescriptorSetLayout getSetLayout() const { return setLayout; }
+	VkDescriptorSet getSet(uint32_t frameSlot) const { return sets[frameSlot]; }
+	uint32_t count() const { return static_cast<uint32_t>(textures.size()); }
+
+private:
+	struct Texture {
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE; // Null while a streamed texture has no resident level
+		GpuAllocation memory;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t mipLevels = 1;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	GpuAllocator* allocator = nullptr;
+	AsyncUploader* uploader = nullptr;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> sets; // Per frame slot
+	std::vector<std::vector<uint32_t>> pendingWrites; // Per frame slot, the array slots its copy is still missing
+	VkSampler sampler = VK_NULL_HANDLE;
+	uint32_t capacity = 0; // MAX_TEXTURES, or less when the device limit is lower
+
+	std::vector<Texture> textures; // Indexed like the descriptor array
+	Texture placeholder;
+
+	Texture createImage(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels);
+	void upload(const Texture& texture, uint32_t width, uint32_t height, const void* rgba);
+	VkImageView createView(const Texture& texture, uint32_t baseMipLevel);
+	void destroyTexture(Texture& texture);
+	void queueWrite(uint32_t index);
+	uint32_t addTexture(Texture texture);
+};
+
+#endif // !TEXTUREMANAGER_H
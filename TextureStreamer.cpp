@@ -0,0 +1,411 @@
+#include "TextureStreamer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <stdexcept>
+
+// The first 12 bytes of every KTX2 file
+static const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+// Copies in the ring start on this alignment, a multiple of 4 and of every supported block size
+static const VkDeviceSize RING_ALIGNMENT = 16;
+
+/// <summary>
+/// The fixed part of a KTX2 header, followed by levelCount Ktx2Level entries
+/// </summary>
+struct Ktx2Header {
+	uint8_t identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "The KTX2 level index starts at byte 80");
+
+struct Ktx2Level {
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+/// <summary>
+/// Block dimensions and size of the formats the streamer can copy, false for anything else
+/// </summary>
+static bool getBlockInfo(VkFormat format, uint32_t& blockWidth, uint32_t& blockHeight, uint32_t& blockSize) {
+	blockWidth = blockHeight = 1;
+
+	switch (format) {
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		blockSize = 4;
+		return true;
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		blockSize = 8;
+		return true;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		blockSize = 16;
+		return true;
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		blockWidth = blockHeight = 4;
+		blockSize = 8;
+		return true;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		blockWidth = blockHeight = 4;
+		blockSize = 16;
+		return true;
+	default:
+		return false;
+	}
+}
+
+/// <summary>
+/// Creates the staging ring, it stays mapped until destroy
+/// </summary>
+/// <param name="ringSize">Bytes of staging memory, bounds the data in flight between the CPU and the GPU</param>
+/// <param name="frameBudget">Bytes copied per frame at most, a single block row larger than this still goes through alone</param>
+void TextureStreamer::init(VkDevice device, VkPhysicalDevice physicalDevice, GpuAllocator* allocator, TextureManager* textures,
+	DeletionQueue* deletionQueue, VkDeviceSize ringSize, VkDeviceSize frameBudget) {
+	this->device = device;
+	this->physicalDevice = physicalDevice;
+	this->allocator = allocator;
+	this->textures = textures;
+	this->deletionQueue = deletionQueue;
+	this->ringSize = ringSize;
+	this->frameBudget = std::min(frameBudget, ringSize);
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = ringSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &ring) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the texture staging ring!");
+	}
+	ringMemory = allocator->allocateBuffer(ring, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+/// <summary>
+/// Drops the unfinished streams and frees the ring, the device must be idle. The images belong to the TextureManager
+/// </summary>
+void TextureStreamer::destroy() {
+	if (device == VK_NULL_HANDLE) { return; }
+
+	streams.clear();
+	spans.clear();
+
+	vkDestroyBuffer(device, ring, nullptr);
+	allocator->free(ringMemory);
+	device = VK_NULL_HANDLE;
+}
+
+/// <summary>
+/// Maps a KTX2 file, checks it and creates the texture. Only 2D textures without supercompression and with every
+/// mip level stored in the file are accepted, the levels are never generated on the CPU
+/// </summary>
+/// <returns>The index of the texture in the descriptor array, it shows the placeholder until the smallest level is resident</returns>
+uint32_t TextureStreamer::load(const std::string& path) {
+	Stream stream;
+	stream.path = path;
+	stream.file = IOHelper::mapFile(path.c_str());
+
+	Ktx2Header header;
+	if (stream.file.size() < sizeof(header) || std::memcmp(stream.file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+		throw std::runtime_error(std::format("\n{} is not a KTX2 file!", path));
+	}
+	std::memcpy(&header, stream.file.data(), sizeof(header));
+
+	if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 || header.layerCount > 1 || header.faceCount != 1) {
+		throw std::runtime_error(std::format("\n{} is not a plain 2D texture!", path));
+	}
+	if (header.supercompressionScheme != 0) {
+		throw std::runtime_error(std::format("\n{} is supercompressed, which isn't supported!", path));
+	}
+	if (header.levelCount == 0) {
+		throw std::runtime_error(std::format("\n{} has no precomputed mip levels!", path));
+	}
+	// floor(log2(max(width, height))) + 1, which also keeps the shifts below under 32
+	uint32_t fullChain = std::bit_width(std::max(header.pixelWidth, header.pixelHeight));
+	if (header.levelCount > fullChain) {
+		throw std::runtime_error(std::format("\n{} has {} mip levels, more than the {} of a full chain!", path, header.levelCount, fullChain));
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	if (std::max(header.pixelWidth, header.pixelHeight) > properties.limits.maxImageDimension2D) {
+		throw std::runtime_error(std::format("\n{} is larger than the GPU's {} pixel limit!", path, properties.limits.maxImageDimension2D));
+	}
+
+	VkFormat format = static_cast<VkFormat>(header.vkFormat);
+	if (!getBlockInfo(format, stream.blockWidth, stream.blockHeight, stream.blockSize)) {
+		throw std::runtime_error(std::format("\n{} has an unsupported format ({})!", path, header.vkFormat));
+	}
+
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+	// The levels are copied in from the staging ring, then sampled
+	VkFormatFeatureFlags neededFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	if ((formatProperties.optimalTilingFeatures & neededFeatures) != neededFeatures) {
+		throw std::runtime_error(std::format("\nThe GPU can't copy to and sample the format of {} ({})!", path, header.vkFormat));
+	}
+
+	size_t indexEnd = sizeof(header) + static_cast<size_t>(header.levelCount) * sizeof(Ktx2Level);
+	if (stream.file.size() < indexEnd) {
+		throw std::runtime_error(std::format("\n{} is truncated!", path));
+	}
+
+	for (uint32_t i = 0; i < header.levelCount; i++) {
+		Ktx2Level entry;
+		std::memcpy(&entry, stream.file.data() + sizeof(header) + i * sizeof(Ktx2Level), sizeof(entry));
+
+		Level level;
+		level.fileOffset = entry.byteOffset;
+		level.size = entry.byteLength;
+		level.width = std::max(header.pixelWidth >> i, 1u);
+		level.height = std::max(header.pixelHeight >> i, 1u);
+
+		// Rows of blocks are tightly packed, so any whole number of them can be copied on its own
+		VkDeviceSize expected = static_cast<VkDeviceSize>((level.width + stream.blockWidth - 1) / stream.blockWidth) *
+			((level.height + stream.blockHeight - 1) / stream.blockHeight) * stream.blockSize;
+		if (level.size != expected || level.fileOffset + level.size > stream.file.size()) {
+			throw std::runtime_error(std::format("\nMip level {} of {} is malformed!", i, path));
+		}
+
+		stream.levels.push_back(level);
+	}
+
+	stream.textureIndex = textures->createStreamedTexture(format, header.pixelWidth, header.pixelHeight, header.levelCount);
+	stream.image = textures->getImage(stream.textureIndex);
+	stream.nextLevel = header.levelCount - 1;
+	stream.residentLevel = header.levelCount;
+
+	uint32_t index = stream.textureIndex;
+	streams.push_back(std::move(stream));
+
+	return index;
+}
+
+/// <summary>
+/// Reclaims the ring space of completed frames and makes the levels they copied visible, retiring the views they replace
+/// </summary>
+/// <param name="frame">The frame about to be recorded, the first one to see the new views</param>
+void TextureStreamer::collect(uint64_t frame, uint64_t completedFrames) {
+	while (!spans.empty() && spans.front().frame < completedFrames) {
+		VkDeviceSize end = spans.front().end;
+		spans.pop_front();
+
+		if (spans.empty()) {
+			used = 0;
+			tail = head;
+		}
+		else {
+			used -= end >= tail ? end - tail : ringSize - tail + end;
+			tail = end;
+		}
+	}
+
+	for (auto& stream : streams) {
+		// Only the largest finished level needs a view, the smaller ones are part of it
+		uint32_t level = stream.residentLevel;
+		while (!stream.completedLevels.empty() && stream.completedLevels.front().second < completedFrames) {
+			level = stream.completedLevels.front().first;
+			stream.completedLevels.pop_front();
+		}
+		if (level == stream.residentLevel) { continue; }
+
+		stream.residentLevel = level;
+		VkImageView previous = textures->setBaseMipLevel(stream.textureIndex, level);
+		if (previous != VK_NULL_HANDLE) {
+			// Every frame from this one on gets the new view, as each frame slot's copy of the array is rewritten
+			// before it is used again. The frames before it may still sample the old one
+			VkDevice device = this->device;
+			deletionQueue->push(frame, [device, previous]() {
+				vkDestroyImageView(device, previous, nullptr);
+			});
+		}
+	}
+
+	std::erase_if(streams, [](const Stream& stream) {
+#ifndef NDEBUG
+		if (stream.residentLevel == 0) {
+			std::cout << "Streamed " << stream.path << " (" << stream.levels.size() << " mip levels)\n";
+		}
+#endif // !NDEBUG
+		return stream.residentLevel == 0;
+	});
+}
+
+/// <summary>
+/// Copies up to frameBudget bytes of pending mip levels into the images, always continuing with the smallest pending level,
+/// so every texture gets a low resolution version before any of them gets its larger levels. Must be recorded outside rendering
+/// </summary>
+void TextureStreamer::record(VkCommandBuffer comBuffer, uint64_t frame) {
+	struct Copy {
+		VkImage image;
+		VkBufferImageCopy region;
+	};
+	std::vector<VkImageMemoryBarrier> toTransfer;
+	std::vector<VkImageMemoryBarrier> toShader;
+	std::vector<Copy> copies;
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	VkDeviceSize spent = 0;
+	while (spent < frameBudget) {
+		Stream* stream = nextStream();
+		if (stream == nullptr) { break; }
+
+		const Level& level = stream->levels[stream->nextLevel];
+		uint32_t blockRows = (level.height + stream->blockHeight - 1) / stream->blockHeight;
+		VkDeviceSize rowSize = level.size / blockRows;
+
+		uint32_t rows = static_cast<uint32_t>(std::min<VkDeviceSize>((frameBudget - spent) / rowSize, blockRows - stream->rowsCopied));
+		if (rows == 0) {
+			if (spent > 0) { break; }
+			rows = 1;
+		}
+
+		VkDeviceSize size = rows * rowSize;
+		VkDeviceSize offset = 0;
+		if (!allocateRing(size, offset)) { break; }
+
+		std::memcpy(static_cast<char*>(ringMemory.mapped) + offset, stream->file.data() + level.fileOffset + stream->rowsCopied * rowSize, size);
+
+		barrier.image = stream->image;
+		barrier.subresourceRange.baseMipLevel = stream->nextLevel;
+		if (stream->rowsCopied == 0) {
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			toTransfer.push_back(barrier);
+		}
+
+		uint32_t firstY = stream->rowsCopied * stream->blockHeight;
+		Copy copy{};
+		copy.image = stream->image;
+		copy.region.bufferOffset = offset;
+		copy.region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, stream->nextLevel, 0, 1 };
+		copy.region.imageOffset = { 0, static_cast<int32_t>(firstY), 0 };
+		copy.region.imageExtent = { level.width, std::min(rows * stream->blockHeight, level.height - firstY), 1 };
+		copies.push_back(copy);
+
+		spent += size;
+		stream->rowsCopied += rows;
+		if (stream->rowsCopied < blockRows) { continue; }
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		toShader.push_back(barrier);
+
+		stream->completedLevels.push_back({ stream->nextLevel, frame });
+		stream->rowsCopied = 0;
+		if (stream->nextLevel == 0) {
+			stream->copied = true; // The stream stays until the full resolution is visible
+		}
+		else {
+			stream->nextLevel--;
+		}
+	}
+
+	if (copies.empty()) { return; }
+	spans.push_back({ frame, head });
+
+	if (!toTransfer.empty()) {
+		vkCmdPipelineBarrier(comBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, static_cast<uint32_t>(toTransfer.size()), toTransfer.data());
+	}
+
+	for (const auto& copy : copies) {
+		vkCmdCopyBufferToImage(comBuffer, ring, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+	}
+
+	if (!toShader.empty()) {
+		vkCmdPipelineBarrier(comBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, static_cast<uint32_t>(toShader.size()), toShader.data());
+	}
+}
+
+/// <summary>
+/// Takes size bytes from the ring, wrapping to the start when the end is too short. The skipped end counts as used
+/// until the frame that wrapped has completed
+/// </summary>
+bool TextureStreamer::allocateRing(VkDeviceSize size, VkDeviceSize& offset) {
+	size = (size + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+	if (size > ringSize) { return false; }
+
+	if (used == 0) {
+		head = tail = 0;
+	}
+
+	if (head >= tail && used < ringSize) {
+		if (ringSize - head >= size) {
+			offset = head;
+		}
+		else if (tail >= size) {
+			used += ringSize - head;
+			offset = 0;
+		}
+		else {
+			return false;
+		}
+	}
+	else if (head < tail && tail - head >= size) {
+		offset = head;
+	}
+	else {
+		return false;
+	}
+
+	head = offset + size;
+	used += size;
+	if (head == ringSize) {
+		head = 0;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// The stream whose next level is the smallest, the oldest one on ties
+/// </summary>
+TextureStreamer::Stream* TextureStreamer::nextStream() {
+	Stream* best = nullptr;
+	for (auto& stream : streams) {
+		if (stream.copied) { continue; }
+		if (best == nullptr || stream.levels[stream.nextLevel].size < best->levels[best->nextLevel].size) {
+			best = &stream;
+		}
+	}
+	return best;
+}
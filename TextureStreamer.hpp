@@ -0,0 +1,91 @@
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include <vulkan/vulkan.h>
+
+#include "DeletionQueue.hpp"
+#include "GpuAllocator.hpp"
+#include "IO.hpp"
+#include "TextureManager.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Streams KTX2 textures with precomputed mip chains into TextureManager slots, from the smallest level to the largest.
+/// The files are memory mapped and copied piecewise through a persistently mapped staging ring, at most frameBudget bytes
+/// per frame, so the cost of a frame stays bounded however many textures are waiting. A texture is usable right away,
+/// showing the placeholder, then its smallest level, and sharpens as every larger level completes on the GPU
+/// </summary>
+class TextureStreamer {
+public:
+	static constexpr VkDeviceSize DEFAULT_RING_SIZE = 16ull << 20;
+	static constexpr VkDeviceSize DEFAULT_FRAME_BUDGET = 2ull << 20;
+
+	void init(VkDevice device, VkPhysicalDevice physicalDevice, GpuAllocator* allocator, TextureManager* textures, DeletionQueue* deletionQueue,
+		VkDeviceSize ringSize = DEFAULT_RING_SIZE, VkDeviceSize frameBudget = DEFAULT_FRAME_BUDGET);
+	void destroy();
+
+	// Maps the file and creates its image, the levels arrive over the following frames
+	uint32_t load(const std::string& path);
+
+	// Same frame protocol as AsyncUploader, collect after waiting for the frame slot and record before rendering
+	void collect(uint64_t frame, uint64_t completedFrames);
+	void record(VkCommandBuffer comBuffer, uint64_t frame);
+
+	size_t pendingTextures() const { return streams.size(); }
+
+private:
+	struct Level {
+		VkDeviceSize fileOffset = 0;
+		VkDeviceSize size = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	struct Stream {
+		std::string path;
+		MappedFile file;
+		uint32_t textureIndex = 0;
+		VkImage image = VK_NULL_HANDLE;
+		std::vector<Level> levels; // levels[0] is the full resolution
+		uint32_t blockWidth = 1;
+		uint32_t blockHeight = 1;
+		uint32_t blockSize = 4;
+
+		bool copied = false; // Every level has been copied, some may not be visible yet
+		uint32_t nextLevel = 0; // The level being copied, counting down to 0
+		uint32_t rowsCopied = 0; // Block rows of nextLevel already copied
+		uint32_t residentLevel = 0; // Levels from here down to the smallest are visible to the shaders
+		std::deque<std::pair<uint32_t, uint64_t>> completedLevels; // (level, frame that copied its last rows)
+	};
+
+	struct RingSpan {
+		uint64_t frame;
+		VkDeviceSize end;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	GpuAllocator* allocator = nullptr;
+	TextureManager* textures = nullptr;
+	DeletionQueue* deletionQueue = nullptr;
+
+	VkBuffer ring = VK_NULL_HANDLE;
+	GpuAllocation ringMemory;
+	VkDeviceSize ringSize = 0;
+	VkDeviceSize frameBudget = 0;
+	VkDeviceSize head = 0; // Next free byte
+	VkDeviceSize tail = 0; // Oldest byte still read by an incomplete frame
+	VkDeviceSize used = 0;
+	std::deque<RingSpan> spans; // Where each frame's copies end in the ring, in frame order
+
+	std::deque<Stream> streams; // Textures with levels still to copy or to make visible
+
+	bool allocateRing(VkDeviceSize size, VkDeviceSize& offset);
+	Stream* nextStream();
+};
+
+#endif // !TEXTURESTREAMER_H
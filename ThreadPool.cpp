@@ -0,0 +1,115 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::~ThreadPool() {
+	destroy();
+}
+
+/// <summary>
+/// Starts the worker threads, an already running pool is stopped first
+/// </summary>
+void ThreadPool::init(uint32_t threadCount) {
+	destroy();
+
+	stopping = false;
+	for (uint32_t i = 0; i < threadCount; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+/// <summary>
+/// Finishes the queued tasks and joins the worker threads
+/// </summary>
+void ThreadPool::destroy() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	taskReady.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	taskReady.notify_one();
+}
+
+/// <summary>
+/// Blocks until every submitted task has finished, the first exception thrown by a task is rethrown here
+/// </summary>
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	tasksDone.wait(lock, [this] { return tasks.empty() && running == 0; });
+
+	if (error) {
+		std::exception_ptr e = error;
+		error = nullptr;
+		std::rethrow_exception(e);
+	}
+}
+
+/// <summary>
+/// Runs task(0) to task(count - 1) on the workers and waits for all of them. Without workers it runs them on the calling thread
+/// </summary>
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t)>& task) {
+	if (workers.empty()) {
+		for (uint32_t i = 0; i < count; i++) {
+			task(i);
+		}
+		return;
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		submit([&task, i] { task(i); });
+	}
+	wait();
+}
+
+uint32_t ThreadPool::size() const {
+	return static_cast<uint32_t>(workers.size());
+}
+
+/// <summary>
+/// Number of hardware threads, at least 1 even when the platform can't tell
+/// </summary>
+uint32_t ThreadPool::hardwareThreads() {
+	uint32_t count = std::thread::hardware_concurrency();
+	return count > 0 ? count : 1;
+}
+
+void ThreadPool::workerLoop() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			taskReady.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (tasks.empty()) { return; }
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+			running++;
+		}
+
+		try {
+			task();
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!error) {
+				error = std::current_exception();
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running--;
+		}
+		tasksDone.notify_all();
+	}
+}
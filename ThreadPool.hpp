@@ -0,0 +1,44 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Fixed set of worker threads pulling tasks from a shared queue
+/// </summary>
+class ThreadPool {
+public:
+	~ThreadPool();
+
+	void init(uint32_t threadCount);
+	void destroy();
+
+	void submit(std::function<void()> task);
+	void wait();
+	void parallelFor(uint32_t count, const std::function<void(uint32_t)>& task);
+
+	uint32_t size() const;
+	static uint32_t hardwareThreads();
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable taskReady;
+	std::condition_variable tasksDone;
+
+	uint32_t running = 0;
+	bool stopping = false;
+	std::exception_ptr error;
+
+	void workerLoop();
+};
+
+#endif // !THREADPOOL_H
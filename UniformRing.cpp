@@ -0,0 +1,116 @@
+#include "UniformRing.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+/// <param name="frameSize">Bytes of uniform data a frame may allocate, rounded up to the offset alignment</param>
+void UniformRing::init(VkDevice device, VkPhysicalDevice physicalDevice, GpuAllocator* allocator, uint32_t framesInFlight, VkDeviceSize frameSize) {
+	this->device = device;
+	this->allocator = allocator;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+	this->frameSize = (frameSize + alignment - 1) / alignment * alignment;
+
+	// The last allocation's descriptor range may reach past its data, so the buffer is padded by one range
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = this->frameSize * framesInFlight + MAX_RANGE;
+	bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the uniform ring!");
+	}
+	memory = allocator->allocateBuffer(buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	VkDescriptorSetLayoutBinding binding{};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the uniform ring descriptor set layout!");
+	}
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSize.descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create the uniform ring descriptor pool!");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &setLayout;
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate the uniform ring descriptor set!");
+	}
+
+	// Written once, every frame only changes the dynamic offset
+	VkDescriptorBufferInfo bufferDescriptor{};
+	bufferDescriptor.buffer = buffer;
+	bufferDescriptor.offset = 0;
+	bufferDescriptor.range = MAX_RANGE;
+
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	write.pBufferInfo = &bufferDescriptor;
+
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
+void UniformRing::destroy() {
+	if (device == VK_NULL_HANDLE) { return; }
+
+	vkDestroyDescriptorPool(device, pool, nullptr);
+	vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	vkDestroyBuffer(device, buffer, nullptr);
+	allocator->free(memory);
+	device = VK_NULL_HANDLE;
+}
+
+/// <summary>
+/// Switches to the slot's region and rewinds it, the slot's previous frame must have completed
+/// </summary>
+void UniformRing::beginFrame(uint32_t frameSlot) {
+	frameStart = frameSlot * frameSize;
+	head = 0;
+}
+
+/// <summary>
+/// Takes size bytes from the current frame's region
+/// </summary>
+/// <param name="dynamicOffset">Receives the offset to bind the descriptor set with</param>
+/// <returns>Where to write the data, it's host coherent so nothing needs flushing</returns>
+void* UniformRing::allocate(VkDeviceSize size, uint32_t& dynamicOffset) {
+	if (head + size > frameSize) {
+		throw std::runtime_error("The uniform ring is out of space for this frame!");
+	}
+
+	dynamicOffset = static_cast<uint32_t>(frameStart + head);
+	head = (head + size + alignment - 1) / alignment * alignment;
+
+	return static_cast<char*>(memory.mapped) + dynamicOffset;
+}
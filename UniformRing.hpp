@@ -0,0 +1,60 @@
+#ifndef UNIFORMRING_H
+#define UNIFORMRING_H
+
+#include <vulkan/vulkan.h>
+
+#include "GpuAllocator.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+/// <summary>
+/// Per-frame uniform data in one persistently mapped, host coherent buffer with a region per frame slot.
+/// Allocating is a pointer bump inside the current slot's region, and the whole buffer is described by a single
+/// UNIFORM_BUFFER_DYNAMIC descriptor, so the data is selected by the dynamic offset at bind time instead of by
+/// mapping memory or updating descriptors. A region is rewound by beginFrame once the slot's previous frame has completed.
+/// Only used from the main thread, recording threads get the offsets
+/// </summary>
+class UniformRing {
+public:
+	static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 64 * 1024;
+	static constexpr VkDeviceSize MAX_RANGE = 256; // The descriptor's range, the largest block a shader can see at one offset
+
+	void init(VkDevice device, VkPhysicalDevice physicalDevice, GpuAllocator* allocator, uint32_t framesInFlight,
+		VkDeviceSize frameSize = DEFAULT_FRAME_SIZE);
+	void destroy();
+
+	void beginFrame(uint32_t frameSlot);
+	void* allocate(VkDeviceSize size, uint32_t& dynamicOffset);
+
+	// Copies the data into the current frame's region, returns its dynamic offset
+	template <typename T>
+	uint32_t push(const T& data) {
+		static_assert(sizeof(T) <= MAX_RANGE, "Uniform blocks must fit in the descriptor's range");
+
+		uint32_t dynamicOffset;
+		std::memcpy(allocate(sizeof(T), dynamicOffset), &data, sizeof(T));
+		return dynamicOffset;
+	}
+
+	VkDescriptorSetLayout getSetLayout() const { return setLayout; }
+	VkDescriptorSet getSet() const { return set; }
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	GpuAllocator* allocator = nullptr;
+
+	VkBuffer buffer = VK_NULL_HANDLE;
+	GpuAllocation memory;
+	VkDeviceSize alignment = 0; // minUniformBufferOffsetAlignment
+	VkDeviceSize frameSize = 0;
+
+	VkDeviceSize frameStart = 0; // The current slot's region
+	VkDeviceSize head = 0; // Next free byte, relative to frameStart
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	VkDescriptorSet set = VK_NULL_HANDLE;
+};
+
+#endif // !UNIFORMRING_H
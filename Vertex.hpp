@@ -0,0 +1,123 @@
+#ifndef VERTEX_H
+#define VERTEX_H
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// A vertex as it is laid out in the vertex buffer (binding 0)
+/// </summary>
+struct Vertex {
+	glm::vec2 pos;
+	glm::vec3 color;
+
+	static VkVertexInputBindingDescription getBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(Vertex);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+		attributeDescriptions[0].offset = offsetof(Vertex, pos);
+
+		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[1].offset = offsetof(Vertex, color);
+
+		return attributeDescriptions;
+	}
+};
+
+/// <summary>
+/// Per instance attributes (binding 1), the quad is scaled, then moved and its vertex colors are tinted.
+/// With bindless textures it is also textured with the TextureManager's texture at textureIndex
+/// </summary>
+struct InstanceData {
+	glm::vec2 offset;
+	glm::vec2 scale;
+	glm::vec3 color;
+	uint32_t textureIndex;
+
+	static VkVertexInputBindingDescription getBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 1;
+		bindingDescription.stride = sizeof(InstanceData);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+
+		attributeDescriptions[0].binding = 1;
+		attributeDescriptions[0].location = 2;
+		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+		attributeDescriptions[0].offset = offsetof(InstanceData, offset);
+
+		attributeDescriptions[1].binding = 1;
+		attributeDescriptions[1].location = 3;
+		attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+		attributeDescriptions[1].offset = offsetof(InstanceData, scale);
+
+		attributeDescriptions[2].binding = 1;
+		attributeDescriptions[2].location = 4;
+		attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[2].offset = offsetof(InstanceData, color);
+
+		attributeDescriptions[3].binding = 1;
+		attributeDescriptions[3].location = 5;
+		attributeDescriptions[3].format = VK_FORMAT_R32_UINT;
+		attributeDescriptions[3].offset = offsetof(InstanceData, textureIndex);
+
+		return attributeDescriptions;
+	}
+};
+
+// instances.comp writes the same layout as a std430 struct
+static_assert(sizeof(InstanceData) == 32 && offsetof(InstanceData, color) == 16 && offsetof(InstanceData, textureIndex) == 28,
+	"InstanceData no longer matches the Instance struct in instances.comp");
+
+/// <summary>
+/// The per-frame uniform block (set 0, binding 0) of shader.vert, written to the UniformRing once per frame
+/// </summary>
+struct FrameUniforms {
+	glm::mat4 viewProjection;
+};
+
+/// <summary>
+/// The push constant block of shader.vert, moves and scales every instance of a draw. Always identity for now, recordDraws pushes it once per command buffer
+/// </summary>
+struct DrawConstants {
+	glm::vec2 offset = { 0.0f, 0.0f };
+	glm::vec2 scale = { 1.0f, 1.0f };
+};
+
+// The quad that used to be hardcoded in shader.vert, as 4 shared vertices instead of 6
+const std::vector<Vertex> quadVertices = {
+	{ { -0.5f, 0.5f }, { 1.0f, 0.0f, 0.0f } },
+	{ { 0.5f, -0.5f }, { 0.0f, 1.0f, 0.0f } },
+	{ { -0.5f, -0.5f }, { 0.0f, 0.0f, 1.0f } },
+	{ { 0.5f, 0.5f }, { 0.0f, 0.0f, 1.0f } }
+};
+
+const std::vector<uint16_t> quadIndices = {
+	0, 1, 2,
+	0, 3, 1
+};
+
+#endif // !VERTEX_H
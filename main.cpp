@@ -1,10 +1,152 @@
 #include "Swagkant.hpp"
 
-int main() {
+#include <cstring>
+
+/// <summary>
+/// Parses the command line into the app settings
+///   --frames-in-flight N   Depth of the frame ring (1-3)
+///   --benchmark S          Run for S seconds, then print the frame stats and exit
+///   --headless             Render offscreen without a window, surface or swap chain
+///   --frames N             Number of frames to render in headless mode
+///   --gpu-stats FILE       Dump the per frame GPU timings and pipeline statistics to FILE (.csv or .json)
+///   --no-pipeline-cache    Don't load or save the on-disk pipeline cache
+///   --bench-allocator      Benchmark the GPU memory allocator and exit
+///   --instances N          Number of quads drawn with one instanced draw call
+///   --bench-instances      Sweep the instance count from 1 to 1M, print the record and frame times and exit
+///   --draws N              Split the instances into N draw calls
+///   --record-threads N     Record the draws on N worker threads into secondary command buffers (0 records inline)
+///   --bench-record         Sweep the number of recording threads, print the record times and exit
+///   --bench-resize         Resize the window back and forth while rendering, print the frame time spikes and exit
+///   --compute              Animate the instances with a compute shader, on an async compute queue when there is one
+///   --timeline             Synchronize the frames with timeline semaphores instead of fences, needs Vulkan 1.2
+///   --dynamic-rendering    Render with VK_KHR_dynamic_rendering instead of a render pass and framebuffers
+///   --gpu UUID             Use the GPU with this deviceUUID instead of the best ranked one (also SWAGKANT_DEVICE_UUID)
+///   --probe-gpus           Rank the GPUs with a short copy benchmark as well
+///   --variant NAME         Draw with one of the specialized pipeline variants, e.g. vertex-color or alpha-tested
+///   --textures             Texture the quads from a bindless descriptor array, needs Vulkan 1.2 and descriptor indexing
+///   --texture PATH         Stream a KTX2 texture with its mip chain instead of the procedural ones, may be repeated
+///   --stream-budget KB     Texture data streamed per frame at most (default 2048)
+///   --gpu-culling          Cull the instances in a compute shader and draw the visible ones with indirect draws
+///   --zoom Z               Scale the view by Z, above 1 pushes instances off screen for the culling to skip
+///   --cpu-culling          Cull the instances on the CPU with SIMD every frame and draw only the visible ones
+///   --bench-culling        Benchmark the scalar and SIMD culling kernels on 1M spheres and exit
+///   --scene                Animate the instances as a transform hierarchy updated on the CPU every frame
+///   --print-graph          Print the first frame's render graph with its generated barriers
+/// </summary>
+static AppSettings parseArgs(int argc, char** argv) {
+	AppSettings settings;
+
+	if (const char* uuid = std::getenv("SWAGKANT_DEVICE_UUID")) {
+		settings.deviceUuid = uuid;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+
+		if (strcmp(argv[i], "--frames-in-flight") == 0 && hasValue) {
+			settings.framesInFlight = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--benchmark") == 0 && hasValue) {
+			settings.benchmarkSeconds = std::stod(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--headless") == 0) {
+			settings.headless = true;
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+			settings.headlessFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--gpu-stats") == 0 && hasValue) {
+			settings.gpuStatsPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--no-pipeline-cache") == 0) {
+			settings.usePipelineCache = false;
+		}
+		else if (strcmp(argv[i], "--bench-allocator") == 0) {
+			settings.benchAllocator = true;
+		}
+		else if (strcmp(argv[i], "--instances") == 0 && hasValue) {
+			settings.instanceCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--bench-instances") == 0) {
+			settings.benchInstances = true;
+		}
+		else if (strcmp(argv[i], "--draws") == 0 && hasValue) {
+			settings.drawCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--record-threads") == 0 && hasValue) {
+			settings.recordThreads = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--bench-record") == 0) {
+			settings.benchRecord = true;
+		}
+		else if (strcmp(argv[i], "--bench-resize") == 0) {
+			settings.benchResize = true;
+		}
+		else if (strcmp(argv[i], "--compute") == 0) {
+			settings.computeInstances = true;
+		}
+		else if (strcmp(argv[i], "--timeline") == 0) {
+			settings.timelineSemaphores = true;
+		}
+		else if (strcmp(argv[i], "--dynamic-rendering") == 0) {
+			settings.dynamicRendering = true;
+		}
+		else if (strcmp(argv[i], "--gpu") == 0 && hasValue) {
+			settings.deviceUuid = argv[++i];
+		}
+		else if (strcmp(argv[i], "--probe-gpus") == 0) {
+			settings.probeDevices = true;
+		}
+		else if (strcmp(argv[i], "--variant") == 0 && hasValue) {
+			auto variant = findPipelineVariant(argv[++i]);
+			if (variant.has_value()) {
+				settings.pipelineVariant = variant.value();
+			}
+			else {
+				std::cerr << "Unknown pipeline variant: " << argv[i] << "\n";
+			}
+		}
+		else if (strcmp(argv[i], "--textures") == 0) {
+			settings.bindlessTextures = true;
+		}
+		else if (strcmp(argv[i], "--texture") == 0 && hasValue) {
+			settings.texturePaths.push_back(argv[++i]);
+			settings.bindlessTextures = true;
+		}
+		else if (strcmp(argv[i], "--stream-budget") == 0 && hasValue) {
+			settings.streamBudgetKb = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+		}
+		else if (strcmp(argv[i], "--gpu-culling") == 0) {
+			settings.gpuCulling = true;
+		}
+		else if (strcmp(argv[i], "--zoom") == 0 && hasValue) {
+			settings.cameraZoom = std::max(0.01f, std::stof(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--cpu-culling") == 0) {
+			settings.cpuCulling = true;
+		}
+		else if (strcmp(argv[i], "--bench-culling") == 0) {
+			settings.benchCulling = true;
+		}
+		else if (strcmp(argv[i], "--scene") == 0) {
+			settings.scene = true;
+		}
+		else if (strcmp(argv[i], "--print-graph") == 0) {
+			settings.printGraph = true;
+		}
+		else {
+			std::cerr << "Unknown argument: " << argv[i] << "\n";
+		}
+	}
+
+	return settings;
+}
+
+int main(int argc, char** argv) {
 	SwagkantApp app;
 
 	try {
-		app.run("Schwag");
+		app.run("Schwag", parseArgs(argc, argv));
 	}
 	catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
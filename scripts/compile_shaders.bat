@@ -1,8 +1,12 @@
 @echo off
 
-del *.spv
+rem Compiles the shaders into lists of SPIR-V words, which ShaderRegistry.cpp embeds into the binary
+
+if not exist shaders\generated mkdir shaders\generated
 
 echo Compiling vertex shaders...
-for %%f in (shaders/*.vert) do glslc.exe shaders/%%f -o %%f.spv
+for %%f in (shaders/*.vert) do glslc.exe shaders/%%~nxf -mfmt=num -o shaders/generated/%%~nxf.inc || exit /b 1
 echo Compiling fragment shaders...
-for %%f in (shaders/*.frag) do glslc.exe shaders/%%f -o %%f.spv
+for %%f in (shaders/*.frag) do glslc.exe shaders/%%~nxf -mfmt=num -o shaders/generated/%%~nxf.inc || exit /b 1
+echo Compiling compute shaders...
+for %%f in (shaders/*.comp) do glslc.exe shaders/%%~nxf -mfmt=num -o shaders/generated/%%~nxf.inc || exit /b 1
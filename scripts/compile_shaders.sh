@@ -0,0 +1,13 @@
+#!/bin/sh
+# Compiles the shaders into lists of SPIR-V words, which ShaderRegistry.cpp embeds into the binary
+set -e
+cd "$(dirname "$0")/.."
+
+mkdir -p shaders/generated
+
+for shader in shaders/*.vert shaders/*.frag shaders/*.comp; do
+	[ -e "$shader" ] || continue
+	name=$(basename "$shader")
+	echo "Compiling $name..."
+	glslc "$shader" -mfmt=num -o "shaders/generated/$name.inc"
+done
@@ -1,8 +1,18 @@
 #version 450
 
+// Specialized per pipeline variant, see PipelineVariants.hpp
+layout(constant_id = 2) const bool ALPHA_TEST = false; // Discards fragments whose alpha is below ALPHA_CUTOFF
+layout(constant_id = 3) const float ALPHA_CUTOFF = 0.5;
+
 layout(location = 0) in vec3 fragColor;
 layout(location = 0) out vec4 outColor;
 
 void main() {
+	// There are no textures, so the brightest channel stands in for the alpha
+	float alpha = max(fragColor.r, max(fragColor.g, fragColor.b));
+	if (ALPHA_TEST && alpha < ALPHA_CUTOFF) {
+		discard;
+	}
+
 	outColor = vec4(fragColor, 1.0);
 }
\ No newline at end of file
@@ -1,28 +1,48 @@
 #version 450
 
-layout(location = 0) out vec3 fragColor;
+// Specialized per pipeline variant, see PipelineVariants.hpp
+layout(constant_id = 0) const uint COLOR_SOURCE = 0; // 0 = vertex * instance color, 1 = vertex color, 2 = instance color
+layout(constant_id = 1) const bool INSTANCED = true; // Whether the instance offset and scale are applied
+
+// Written once per frame to the UniformRing, see FrameUniforms in Vertex.hpp
+layout(set = 0, binding = 0) uniform FrameData {
+	mat4 viewProjection;
+} frame;
 
-vec2 positions[6] = vec2[](
-	vec2(-0.5, 0.5),
-	vec2(0.5, -0.5),
-	vec2(-0.5, -0.5),
+// Pushed once per command buffer, see DrawConstants in Vertex.hpp
+layout(push_constant) uniform DrawConstants {
+	vec2 offset;
+	vec2 scale;
+} draw;
 
-	vec2(-0.5, 0.5),
-	vec2(0.5, 0.5),
-	vec2(0.5, -0.5)
-);
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
 
-vec3 colors[6] = vec3[](
-	vec3(1.0, 0.0, 0.0),
-	vec3(0.0, 1.0, 0.0),
-	vec3(0.0, 0.0, 1.0),
+layout(location = 2) in vec2 instanceOffset;
+layout(location = 3) in vec2 instanceScale;
+layout(location = 4) in vec3 instanceColor;
+layout(location = 5) in uint instanceTexture;
 
-	vec3(1.0, 0.0, 0.0),
-	vec3(0.0, 0.0, 1.0),
-	vec3(0.0, 1.0, 0.0)
-);
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragUV; // Only read by textured.frag
+layout(location = 2) flat out uint fragTexture;
 
 void main() {
-	gl_Position = vec4(positions[gl_VertexIndex], 1.0, 1.0);
-	fragColor = colors[gl_VertexIndex];
+	vec2 position = INSTANCED ? inPosition * instanceScale + instanceOffset : inPosition;
+	position = position * draw.scale + draw.offset;
+	gl_Position = frame.viewProjection * vec4(position, 1.0, 1.0);
+
+	// The quad spans -0.5 to 0.5
+	fragUV = inPosition + 0.5;
+	fragTexture = instanceTexture;
+
+	if (COLOR_SOURCE == 1) {
+		fragColor = inColor;
+	}
+	else if (COLOR_SOURCE == 2) {
+		fragColor = instanceColor;
+	}
+	else {
+		fragColor = inColor * instanceColor;
+	}
 }
\ No newline at end of file
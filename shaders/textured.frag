@@ -0,0 +1,25 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Specialized per pipeline variant, see PipelineVariants.hpp
+layout(constant_id = 2) const bool ALPHA_TEST = false; // Discards texels whose alpha is below ALPHA_CUTOFF
+layout(constant_id = 3) const float ALPHA_CUTOFF = 0.5;
+
+// Every texture of the TextureManager, only the slots that have been written are ever indexed
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in uint fragTexture;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	// The index comes from the instance, so it differs within a draw
+	vec4 texel = texture(textures[nonuniformEXT(fragTexture)], fragUV);
+	if (ALPHA_TEST && texel.a < ALPHA_CUTOFF) {
+		discard;
+	}
+
+	outColor = vec4(fragColor * texel.rgb, 1.0);
+}
\ No newline at end of file